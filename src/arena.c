@@ -0,0 +1,73 @@
+#include "arena.h"
+
+#include <mcbsp.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define ARENA_ALIGN 64
+#define ARENA_CHUNK (1 << 20)
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	char *free;
+	char *end;
+};
+
+static void out_of_memory( void ) {
+	bsp_abort( "Processor %u: out of memory\n", bsp_pid() );
+}
+
+void arena_init( struct arena *arena ) {
+	arena->chunks = NULL;
+	arena->registered = NULL;
+	arena->nregistered = arena->capacity = 0;
+}
+
+void * arena_alloc( struct arena *arena, size_t bytes ) {
+	bytes = (bytes + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+	if( bytes == 0 )
+		bytes = ARENA_ALIGN;
+	struct arena_chunk *chunk = arena->chunks;
+	if( chunk == NULL || (size_t) (chunk->end - chunk->free) < bytes ) {
+		//large buffers get a chunk of their own, small ones share
+		const size_t size = sizeof(struct arena_chunk) + ARENA_ALIGN + (bytes > ARENA_CHUNK ? bytes : ARENA_CHUNK);
+		chunk = malloc( size );
+		if( chunk == NULL )
+			out_of_memory();
+		const uintptr_t first = (uintptr_t) (chunk + 1);
+		chunk->free = (char *) ((first + ARENA_ALIGN - 1) & ~(uintptr_t) (ARENA_ALIGN - 1));
+		chunk->end = (char *) chunk + size;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+	void *ret = chunk->free;
+	chunk->free += bytes;
+	return ret;
+}
+
+void * arena_alloc_registered( struct arena *arena, size_t bytes ) {
+	if( arena->nregistered == arena->capacity ) {
+		arena->capacity = arena->capacity ? 2 * arena->capacity : 8;
+		void **grown = realloc( arena->registered, arena->capacity * sizeof(void *) );
+		if( grown == NULL )
+			out_of_memory();
+		arena->registered = grown;
+	}
+	void *ret = arena_alloc( arena, bytes );
+	bsp_push_reg( ret, bytes );
+	arena->registered[ arena->nregistered++ ] = ret;
+	return ret;
+}
+
+void arena_release( struct arena *arena ) {
+	while( arena->nregistered > 0 )
+		bsp_pop_reg( arena->registered[ --arena->nregistered ] );
+	bsp_sync();
+	while( arena->chunks != NULL ) {
+		struct arena_chunk *next = arena->chunks->next;
+		free( arena->chunks );
+		arena->chunks = next;
+	}
+	free( arena->registered );
+	arena_init( arena );
+}
@@ -0,0 +1,34 @@
+#ifndef _H_ARENA
+#define _H_ARENA
+
+#include <stddef.h>
+
+//Per-thread memory for one SPMD run. Every communication and scratch buffer
+//is carved out of a few large chunks when the run is set up; buffers that
+//other processors write into are registered through the arena as well.
+//arena_release deregisters and frees all of it at once before bsp_end, so
+//nothing is allocated or registered while iterating and nothing leaks.
+
+struct arena_chunk;
+
+struct arena {
+	struct arena_chunk *chunks;
+	//registered buffers, in registration order
+	void **registered;
+	size_t nregistered, capacity;
+};
+
+void arena_init( struct arena *arena );
+
+//returns bytes of cache-line aligned memory; aborts the run when out of memory
+void * arena_alloc( struct arena *arena, size_t bytes );
+
+//as arena_alloc, and registers the buffer with bsp_push_reg. Like
+//bsp_push_reg itself this must be called in the same order on all
+//processors and takes effect after the next sync.
+void * arena_alloc_registered( struct arena *arena, size_t bytes );
+
+//collective: deregisters every registered buffer, syncs, and frees all memory
+void arena_release( struct arena *arena );
+
+#endif
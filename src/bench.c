@@ -0,0 +1,209 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <mcbsp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "loader.h"
+#include "engine.h"
+
+//Benchmark harness: generates a synthetic graph, runs the engine on it for a
+//sweep of processor counts and reports throughput, time to convergence and
+//parallel efficiency. Strong scaling keeps the graph fixed; weak scaling
+//grows it with the number of processors, so that every processor keeps the
+//same share.
+
+enum generator {
+	//recursive matrix (Kronecker) graph with the Graph500 probabilities
+	GEN_RMAT = 0,
+	//Erdos-Renyi G(n, m): m edges between uniformly random nodes
+	GEN_ER,
+	//square 2D grid, every node linked to its four neighbours
+	GEN_GRID
+};
+
+//splitmix64, so that a graph only depends on its parameters and the seed
+static uint64_t next_random( uint64_t *state ) {
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+//uniform in [0, 1)
+static double next_uniform( uint64_t *state ) {
+	return (next_random( state ) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//generates 2^scale nodes (the nearest square for the grid) with about
+//edge_factor edges per node
+static int generate( struct graph *g, enum generator gen, unsigned int scale, unsigned int edge_factor, uint64_t seed ) {
+	size_t n = (size_t) 1 << scale;
+	size_t side = 0;
+	if( gen == GEN_GRID ) {
+		while( (side + 1) * (side + 1) <= n )
+			++side;
+		n = side * side;
+	}
+	const size_t m = gen == GEN_GRID ? 4 * n : edge_factor * n;
+	uint32_t *src = malloc( (m ? m : 1) * sizeof(uint32_t) );
+	uint32_t *dst = malloc( (m ? m : 1) * sizeof(uint32_t) );
+	if( src == NULL || dst == NULL ) {
+		free( src );
+		free( dst );
+		return -1;
+	}
+	size_t count = 0;
+	uint64_t state = seed;
+	if( gen == GEN_RMAT ) {
+		const double a = 0.57, b = 0.19, c = 0.19;
+		for( ; count < m; ++count ) {
+			uint32_t i = 0, j = 0;
+			for( unsigned int bit = 0; bit < scale; ++bit ) {
+				const double r = next_uniform( &state );
+				i = 2 * i + (r >= a + b);
+				j = 2 * j + ((r >= a && r < a + b) || r >= a + b + c);
+			}
+			src[ count ] = i;
+			dst[ count ] = j;
+		}
+	} else if( gen == GEN_ER ) {
+		for( ; count < m; ++count ) {
+			src[ count ] = next_random( &state ) % n;
+			dst[ count ] = next_random( &state ) % n;
+		}
+	} else {
+		for( size_t r = 0; r < side; ++r ) {
+			for( size_t c = 0; c < side; ++c ) {
+				const uint32_t v = r * side + c;
+				if( r > 0 ) { src[ count ] = v; dst[ count++ ] = v - side; }
+				if( r + 1 < side ) { src[ count ] = v; dst[ count++ ] = v + side; }
+				if( c > 0 ) { src[ count ] = v; dst[ count++ ] = v - 1; }
+				if( c + 1 < side ) { src[ count ] = v; dst[ count++ ] = v + 1; }
+			}
+		}
+	}
+	const int rc = graph_from_edges( g, n, count, src, dst );
+	free( src );
+	free( dst );
+	return rc;
+}
+
+//one run from the uniform start vector
+static int run_once( const struct graph *g, struct engine_config *config, unsigned int P, struct engine_stats *stats ) {
+	double *vector = malloc( (g->A.n ? g->A.n : 1) * sizeof(double) );
+	if( vector == NULL )
+		return -1;
+	for( size_t i = 0; i < g->A.n; ++i )
+		vector[ i ] = 1.0 / g->A.n;
+	config->nprocs = P;
+	pagerank_run( g, config, vector, stats );
+	free( vector );
+	return 0;
+}
+
+int main( int argc, char **argv ) {
+	enum generator gen = GEN_RMAT;
+	unsigned int scale = 16;
+	unsigned int edge_factor = 16;
+	unsigned int max_procs = bsp_nprocs();
+	unsigned int repeats = 3;
+	int weak = 0;
+	uint64_t seed = 1;
+	struct engine_config config = { .damping = ENGINE_DAMPING, .tolerance = 1e-8, .max_iterations = 1000, .norm = NORM_L1, .distribution = DIST_1D };
+	int opt;
+	int usage = 0;
+	while( (opt = getopt( argc, argv, "g:s:e:p:r:d:k:x:t:w" )) != -1 ) {
+		switch( opt ) {
+		case 'g':
+			if( strcmp( optarg, "rmat" ) == 0 )
+				gen = GEN_RMAT;
+			else if( strcmp( optarg, "er" ) == 0 )
+				gen = GEN_ER;
+			else if( strcmp( optarg, "grid" ) == 0 )
+				gen = GEN_GRID;
+			else
+				usage = 1;
+			break;
+		case 's':
+			scale = strtoul( optarg, NULL, 10 );
+			usage |= scale == 0 || scale > 30;
+			break;
+		case 'e':
+			edge_factor = strtoul( optarg, NULL, 10 );
+			break;
+		case 'p':
+			max_procs = strtoul( optarg, NULL, 10 );
+			usage |= max_procs == 0;
+			break;
+		case 'r':
+			repeats = strtoul( optarg, NULL, 10 );
+			usage |= repeats == 0;
+			break;
+		case 'd':
+			if( strcmp( optarg, "1d" ) == 0 )
+				config.distribution = DIST_1D;
+			else if( strcmp( optarg, "2d" ) == 0 )
+				config.distribution = DIST_2D;
+			else
+				usage = 1;
+			break;
+		case 'k':
+			usage |= kernel_parse( optarg, &config.kernel ) != 0;
+			break;
+		case 'x':
+			seed = strtoull( optarg, NULL, 10 );
+			break;
+		case 't':
+			config.tolerance = strtod( optarg, NULL );
+			break;
+		case 'w':
+			weak = 1;
+			break;
+		default:
+			usage = 1;
+		}
+	}
+	if( usage || optind != argc ) {
+		fprintf( stderr, "Usage: %s [-g rmat|er|grid] [-s scale] [-e edge factor] [-p max processors] [-r repeats] [-d 1d|2d] [-k auto|scalar|sse2|avx2|avx512] [-t tolerance] [-x seed] [-w]\n", argv[ 0 ] );
+		return EXIT_FAILURE;
+	}
+
+	//processor counts 1, 2, 4, ... up to max_procs
+	printf( "%s scaling, %s graph of scale %u%s\n", weak ? "Weak" : "Strong", gen == GEN_RMAT ? "R-MAT" : gen == GEN_ER ? "Erdos-Renyi" : "grid", scale, weak ? " per processor" : "" );
+	printf( "%6s %10s %11s %6s %12s %14s %10s %10s\n", "procs", "nodes", "nonzeros", "iters", "time (s)", "edges/s", "speedup", "efficiency" );
+	struct graph graph;
+	memset( &graph, 0, sizeof(graph) );
+	double base = 0.0;
+	for( unsigned int P = 1, log_p = 0; P <= max_procs; P *= 2, ++log_p ) {
+		if( P == 1 || weak ) {
+			graph_free( &graph );
+			if( scale + (weak ? log_p : 0) > 31 || generate( &graph, gen, scale + (weak ? log_p : 0), edge_factor, seed ) != 0 ) {
+				fprintf( stderr, "Could not generate the graph\n" );
+				return EXIT_FAILURE;
+			}
+		}
+		//the fastest of a few runs, to filter out noise
+		struct engine_stats stats, best;
+		memset( &best, 0, sizeof(best) );
+		for( unsigned int r = 0; r < repeats; ++r ) {
+			if( run_once( &graph, &config, P, &stats ) != 0 ) {
+				fprintf( stderr, "Out of memory\n" );
+				return EXIT_FAILURE;
+			}
+			if( r == 0 || stats.time < best.time )
+				best = stats;
+		}
+		if( P == 1 )
+			base = best.time;
+		//strong scaling ideally divides the time by P, weak scaling keeps it
+		const double speedup = base / best.time;
+		const double efficiency = weak ? speedup : speedup / P;
+		printf( "%6u %10zu %11zu %6u %12.6f %14.4g %10.2f %9.1f%%\n", P, graph.A.n, graph.A.nnz, best.iterations, best.time,
+			best.iterations ? graph.A.nnz * (double) best.iterations / best.time : 0.0, weak ? speedup * P : speedup, 100.0 * efficiency );
+	}
+	graph_free( &graph );
+	return EXIT_SUCCESS;
+}
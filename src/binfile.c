@@ -0,0 +1,122 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "binfile.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//rounds a byte count up to the 8-byte alignment of the next array
+static size_t align8( size_t bytes ) {
+	return (bytes + 7) & ~(size_t) 7;
+}
+
+int binfile_detect( const char *path ) {
+	char magic[ 8 ];
+	FILE *file = fopen( path, "rb" );
+	if( file == NULL )
+		return 0;
+	const int match = fread( magic, 1, sizeof(magic), file ) == sizeof(magic)
+		&& (memcmp( magic, BINFILE_MAGIC, sizeof(magic) ) == 0
+		|| memcmp( magic, BINFILE_MAGIC_DEFICIT, sizeof(magic) ) == 0);
+	fclose( file );
+	return match;
+}
+
+static int write_padded( FILE *file, const void *data, size_t bytes ) {
+	static const char zeros[ 8 ] = { 0 };
+	if( bytes > 0 && fwrite( data, 1, bytes, file ) != bytes )
+		return -1;
+	const size_t pad = align8( bytes ) - bytes;
+	if( pad > 0 && fwrite( zeros, 1, pad, file ) != pad )
+		return -1;
+	return 0;
+}
+
+int binfile_write( const char *path, const struct graph *g ) {
+	FILE *file = fopen( path, "wb" );
+	if( file == NULL ) {
+		perror( path );
+		return -1;
+	}
+	struct binfile_header header;
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, g->deficit != NULL ? BINFILE_MAGIC_DEFICIT : BINFILE_MAGIC, sizeof(header.magic) );
+	header.n = g->A.n;
+	header.nnz = g->A.nnz;
+	header.ndangling = g->ndangling;
+	int rc = write_padded( file, &header, sizeof(header) );
+	if( rc == 0 )
+		rc = write_padded( file, g->A.row_start, (g->A.n + 1) * sizeof(uint64_t) );
+	if( rc == 0 )
+		rc = write_padded( file, g->A.col, g->A.nnz * sizeof(uint32_t) );
+	if( rc == 0 )
+		rc = write_padded( file, g->A.val, g->A.nnz * sizeof(double) );
+	if( rc == 0 )
+		rc = write_padded( file, g->dangling, g->ndangling * sizeof(uint32_t) );
+	if( rc == 0 && g->deficit != NULL )
+		rc = write_padded( file, g->deficit, g->ndangling * sizeof(double) );
+	if( fclose( file ) != 0 )
+		rc = -1;
+	if( rc != 0 )
+		fprintf( stderr, "%s: write failed\n", path );
+	return rc;
+}
+
+int binfile_map( const char *path, struct graph *g ) {
+	memset( g, 0, sizeof(*g) );
+	const int fd = open( path, O_RDONLY );
+	if( fd < 0 ) {
+		perror( path );
+		return -1;
+	}
+	struct stat st;
+	void *map = MAP_FAILED;
+	if( fstat( fd, &st ) == 0 && (size_t) st.st_size >= sizeof(struct binfile_header) )
+		map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	//the mapping stays valid after the descriptor is closed
+	close( fd );
+	if( map == MAP_FAILED ) {
+		fprintf( stderr, "%s: could not map file\n", path );
+		return -1;
+	}
+
+	const struct binfile_header *header = map;
+	const char *base = map;
+	size_t offset = sizeof(*header);
+	const size_t row_bytes = (header->n + 1) * sizeof(uint64_t);
+	const size_t col_bytes = align8( header->nnz * sizeof(uint32_t) );
+	const size_t val_bytes = header->nnz * sizeof(double);
+	const size_t dangling_bytes = align8( header->ndangling * sizeof(uint32_t) );
+	const int has_deficit = memcmp( header->magic, BINFILE_MAGIC_DEFICIT, sizeof(header->magic) ) == 0;
+	const size_t deficit_bytes = has_deficit ? header->ndangling * sizeof(double) : 0;
+	//only the header and the last row offset are checked, so that mapping a
+	//file touches no more than two pages
+	if( (!has_deficit && memcmp( header->magic, BINFILE_MAGIC, sizeof(header->magic) ) != 0)
+		|| header->n >= UINT32_MAX
+		|| offset + row_bytes + col_bytes + val_bytes + dangling_bytes + deficit_bytes != (size_t) st.st_size
+		|| ((const uint64_t *) (base + offset))[ header->n ] != header->nnz ) {
+		fprintf( stderr, "%s: not a valid binary graph file\n", path );
+		munmap( map, st.st_size );
+		return -1;
+	}
+	g->A.n = header->n;
+	g->A.nnz = header->nnz;
+	g->A.row_start = (uint64_t *) (base + offset);
+	offset += row_bytes;
+	g->A.col = (uint32_t *) (base + offset);
+	offset += col_bytes;
+	g->A.val = (double *) (base + offset);
+	offset += val_bytes;
+	g->ndangling = header->ndangling;
+	g->dangling = (uint32_t *) (base + offset);
+	offset += dangling_bytes;
+	if( has_deficit )
+		g->deficit = (double *) (base + offset);
+	g->map = map;
+	g->map_length = st.st_size;
+	return 0;
+}
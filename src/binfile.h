@@ -0,0 +1,38 @@
+#ifndef _H_BINFILE
+#define _H_BINFILE
+
+#include "loader.h"
+
+//Binary graph file: a fixed header followed by the arrays of struct graph,
+//each starting on an 8-byte boundary, in native byte order:
+//  struct binfile_header
+//  uint64_t row_start[ n + 1 ]
+//  uint32_t col[ nnz ]          (padded to a multiple of 8 bytes)
+//  double   val[ nnz ]
+//  uint32_t dangling[ ndangling ]   (padded to a multiple of 8 bytes)
+//  double   deficit[ ndangling ]    (BINFILE_MAGIC_DEFICIT files only)
+//Because the layout equals the in-memory layout, a mapped file is used
+//directly by the engine without any parsing or copying.
+
+#define BINFILE_MAGIC "PRCSR01"
+//the same with the deficits of the listed nodes, for graphs that have them
+#define BINFILE_MAGIC_DEFICIT "PRCSR02"
+
+struct binfile_header {
+	char magic[ 8 ];
+	uint64_t n;
+	uint64_t nnz;
+	uint64_t ndangling;
+};
+
+//returns 1 if the file starts with either binary graph magic
+int binfile_detect( const char *path );
+
+//writes g to path, returns 0 on success
+int binfile_write( const char *path, const struct graph *g );
+
+//maps a binary graph file read-only; g->A, g->dangling and g->deficit then point into
+//the mapping, which graph_free releases. Returns 0 on success.
+int binfile_map( const char *path, struct graph *g );
+
+#endif
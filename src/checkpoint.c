@@ -0,0 +1,146 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "checkpoint.h"
+#include "arena.h"
+
+#include <mcbsp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+//<path>.<pid><suffix>, or NULL if out of memory
+static char * file_name( const char *path, int pid, const char *suffix ) {
+	const size_t length = strlen( path ) + strlen( suffix ) + 16;
+	char *name = malloc( length );
+	if( name != NULL )
+		snprintf( name, length, "%s.%d%s", path, pid, suffix );
+	return name;
+}
+
+void checkpoint_init( struct checkpoint_writer *cw, struct arena *arena, const char *path, unsigned int pid, unsigned int nprocs, size_t n, size_t lo, size_t hi ) {
+	memset( cw, 0, sizeof(*cw) );
+	cw->path = file_name( path, pid, "" );
+	cw->tmp = file_name( path, pid, ".tmp" );
+	cw->old = file_name( path, pid, ".old" );
+	if( cw->path == NULL || cw->tmp == NULL || cw->old == NULL )
+		bsp_abort( "Processor %u: out of memory\n", pid );
+	memcpy( cw->header.magic, CHECKPOINT_MAGIC, sizeof(cw->header.magic) );
+	cw->header.n = n;
+	cw->header.lo = lo;
+	cw->header.hi = hi;
+	cw->header.nprocs = nprocs;
+	cw->snapshot = arena_alloc( arena, (hi - lo) * sizeof(double) );
+}
+
+//the background thread: writes the snapshot and renames it into place
+static void * writer( void *arg ) {
+	struct checkpoint_writer *cw = arg;
+	const size_t count = cw->header.hi - cw->header.lo;
+	FILE *file = fopen( cw->tmp, "wb" );
+	int ok = file != NULL
+		&& fwrite( &cw->header, sizeof(cw->header), 1, file ) == 1
+		&& fwrite( cw->snapshot, sizeof(double), count, file ) == count
+		&& fflush( file ) == 0
+		&& fsync( fileno( file ) ) == 0;
+	if( file != NULL && fclose( file ) != 0 )
+		ok = 0;
+	//the current file is only given up once its successor is complete
+	if( ok ) {
+		rename( cw->path, cw->old );
+		ok = rename( cw->tmp, cw->path ) == 0;
+	}
+	if( !ok )
+		fprintf( stderr, "%s: checkpoint write failed\n", cw->tmp );
+	return NULL;
+}
+
+void checkpoint_wait( struct checkpoint_writer *cw ) {
+	if( cw->running )
+		pthread_join( cw->thread, NULL );
+	cw->running = 0;
+}
+
+void checkpoint_write( struct checkpoint_writer *cw, const double *x, unsigned int iteration, double residual ) {
+	checkpoint_wait( cw );
+	memcpy( cw->snapshot, x, (cw->header.hi - cw->header.lo) * sizeof(double) );
+	cw->header.iteration = iteration;
+	cw->header.residual = residual;
+	if( pthread_create( &cw->thread, NULL, writer, cw ) == 0 )
+		cw->running = 1;
+	else
+		writer( cw );
+}
+
+void checkpoint_finish( struct checkpoint_writer *cw ) {
+	checkpoint_wait( cw );
+	free( cw->path );
+	free( cw->tmp );
+	free( cw->old );
+	memset( cw, 0, sizeof(*cw) );
+}
+
+//opens <path>.<pid><suffix> and reads its header; returns 0 if it is a
+//checkpoint of an n-vector, leaving the file positioned at its slice
+static int read_header( const char *path, unsigned int pid, const char *suffix, size_t n, FILE **file, struct checkpoint_header *header ) {
+	char *name = file_name( path, pid, suffix );
+	*file = name != NULL ? fopen( name, "rb" ) : NULL;
+	free( name );
+	if( *file == NULL )
+		return -1;
+	if( fread( header, sizeof(*header), 1, *file ) != 1
+		|| memcmp( header->magic, CHECKPOINT_MAGIC, sizeof(header->magic) ) != 0
+		|| header->n != n || header->lo > header->hi || header->hi > n ) {
+		fclose( *file );
+		*file = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+int checkpoint_load( const char *path, size_t n, double *x, unsigned int *iteration, double *residual ) {
+	FILE *file;
+	struct checkpoint_header header;
+	if( read_header( path, 0, "", n, &file, &header ) != 0 ) {
+		fprintf( stderr, "%s.0: not a checkpoint of a graph with %zu nodes\n", path, n );
+		return -1;
+	}
+	fclose( file );
+	const unsigned int nprocs = header.nprocs;
+	//every processor holds the newest complete generation or the one after
+	//it, in its current file or, while that is being replaced, in its old
+	//one, so the oldest of their newest files is the newest generation they
+	//all have
+	unsigned int target = UINT32_MAX;
+	for( unsigned int s = 0; s < nprocs; ++s ) {
+		if( read_header( path, s, "", n, &file, &header ) == 0 || read_header( path, s, ".old", n, &file, &header ) == 0 ) {
+			fclose( file );
+			if( header.iteration < target )
+				target = header.iteration;
+		}
+	}
+	size_t covered = 0;
+	for( unsigned int s = 0; s < nprocs; ++s ) {
+		int found = 0;
+		for( unsigned int g = 0; g < 2 && !found; ++g ) {
+			if( read_header( path, s, g == 0 ? "" : ".old", n, &file, &header ) != 0 )
+				continue;
+			found = header.iteration == target && header.nprocs == nprocs
+				&& fread( x + header.lo, sizeof(double), header.hi - header.lo, file ) == header.hi - header.lo;
+			fclose( file );
+		}
+		if( !found ) {
+			fprintf( stderr, "%s: no complete checkpoint for processor %u\n", path, s );
+			return -1;
+		}
+		if( s == 0 )
+			*residual = header.residual;
+		covered += header.hi - header.lo;
+	}
+	if( covered != n ) {
+		fprintf( stderr, "%s: the checkpoint files do not cover the vector\n", path );
+		return -1;
+	}
+	*iteration = target;
+	return 0;
+}
@@ -0,0 +1,67 @@
+#ifndef _H_CHECKPOINT
+#define _H_CHECKPOINT
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//Checkpoints of a run: every processor writes its own slice of the vector to
+//its own file, <path>.<pid>, so there is no gather. The write happens on a
+//background thread from a snapshot of the slice, overlapping the following
+//supersteps. A file is written as <path>.<pid>.tmp and renamed into place,
+//the one it replaces becoming <path>.<pid>.old, so a crash at any moment
+//leaves a complete generation on disk for every processor.
+//
+//File layout, in native byte order: struct checkpoint_header followed by
+//double x[ hi - lo ], entries lo .. hi-1 of the vector.
+
+#define CHECKPOINT_MAGIC "PRCKPT1"
+
+struct checkpoint_header {
+	char magic[ 8 ];
+	uint64_t n;
+	uint64_t lo;
+	uint64_t hi;
+	//number of files the vector is split over
+	uint32_t nprocs;
+	uint32_t iteration;
+	double residual;
+};
+
+struct arena;
+
+struct checkpoint_writer {
+	char *path;
+	char *tmp;
+	char *old;
+	struct checkpoint_header header;
+	double *snapshot;
+	pthread_t thread;
+	int running;
+};
+
+//prepares this processor's writer for the slice [lo, hi) of an n-vector;
+//the snapshot buffer comes from the arena
+void checkpoint_init( struct checkpoint_writer *cw, struct arena *arena, const char *path, unsigned int pid, unsigned int nprocs, size_t n, size_t lo, size_t hi );
+
+//waits for the previous checkpoint of this processor. Called by every
+//processor before the sync that precedes a checkpoint_write, it ensures that
+//no processor gives up its current file before all have completed theirs,
+//so the generations on disk are at most one apart.
+void checkpoint_wait( struct checkpoint_writer *cw );
+
+//waits for the previous checkpoint of this processor, then starts writing
+//the slice x as the state after the given iteration; x may change as soon as
+//this returns
+void checkpoint_write( struct checkpoint_writer *cw, const double *x, unsigned int iteration, double residual );
+
+//waits for the last checkpoint and releases the writer
+void checkpoint_finish( struct checkpoint_writer *cw );
+
+//assembles the n-vector x from the newest checkpoint that is complete for
+//every processor, whatever the number of processors that wrote it, and
+//returns its iteration and residual. Returns 0 on success, otherwise prints
+//a diagnostic to stderr and returns -1.
+int checkpoint_load( const char *path, size_t n, double *x, unsigned int *iteration, double *residual );
+
+#endif
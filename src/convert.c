@@ -0,0 +1,32 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "loader.h"
+#include "binfile.h"
+
+//one-time conversion of a text graph into the binary CSR format that
+//PageRank maps at start-up
+int main( int argc, char **argv ) {
+	enum graph_format format = FORMAT_AUTO;
+	int opt;
+	while( (opt = getopt( argc, argv, "f:" )) != -1 ) {
+		if( opt != 'f' || graph_format_parse( optarg, &format ) != 0 )
+			break;
+	}
+	if( opt != -1 || argc - optind != 2 ) {
+		fprintf( stderr, "Usage: %s [-f auto|edges|mtx|dense] <graph file> <output.bin>\n", argv[ 0 ] );
+		return EXIT_FAILURE;
+	}
+
+	struct graph graph;
+	if( graph_load( argv[ optind ], format, &graph ) != 0 )
+		return EXIT_FAILURE;
+	const int rc = binfile_write( argv[ optind + 1 ], &graph );
+	if( rc == 0 )
+		printf( "%zu nodes, %zu nonzeros, %zu dangling\n", graph.A.n, graph.A.nnz, graph.ndangling );
+	graph_free( &graph );
+	return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
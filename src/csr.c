@@ -0,0 +1,76 @@
+#include "csr.h"
+
+#include <stdlib.h>
+
+int csr_alloc( struct csr *A, size_t n, size_t nnz ) {
+	A->n = n;
+	A->nnz = nnz;
+	A->row_start = malloc( (n + 1) * sizeof(uint64_t) );
+	//never ask malloc for zero bytes, an empty graph is still a valid matrix
+	A->col = malloc( (nnz ? nnz : 1) * sizeof(uint32_t) );
+	A->val = malloc( (nnz ? nnz : 1) * sizeof(double) );
+	if( A->row_start == NULL || A->col == NULL || A->val == NULL ) {
+		csr_free( A );
+		return -1;
+	}
+	A->row_start[ 0 ] = 0;
+	return 0;
+}
+
+int csr_from_dense( struct csr *A, size_t n, const double *dense ) {
+	size_t nnz = 0;
+	for( size_t i = 0; i < n*n; ++i )
+		if( dense[ i ] != 0.0 )
+			++nnz;
+	if( csr_alloc( A, n, nnz ) != 0 )
+		return -1;
+	size_t k = 0;
+	for( size_t i = 0; i < n; ++i ) {
+		for( size_t j = 0; j < n; ++j ) {
+			if( dense[ i*n + j ] != 0.0 ) {
+				A->col[ k ] = j;
+				A->val[ k ] = dense[ i*n + j ];
+				++k;
+			}
+		}
+		A->row_start[ i + 1 ] = k;
+	}
+	return 0;
+}
+
+void csr_free( struct csr *A ) {
+	free( A->row_start );
+	free( A->col );
+	free( A->val );
+	A->row_start = NULL;
+	A->col = NULL;
+	A->val = NULL;
+	A->n = A->nnz = 0;
+}
+
+int csr_transpose_pattern( const struct csr *A, struct csr_pattern *T ) {
+	T->start = calloc( A->n + 1, sizeof(uint64_t) );
+	T->node = malloc( (A->nnz ? A->nnz : 1) * sizeof(uint32_t) );
+	if( T->start == NULL || T->node == NULL ) {
+		csr_pattern_free( T );
+		return -1;
+	}
+	for( size_t k = 0; k < A->nnz; ++k )
+		++T->start[ A->col[ k ] + 1 ];
+	for( size_t j = 0; j < A->n; ++j )
+		T->start[ j + 1 ] += T->start[ j ];
+	for( size_t i = 0; i < A->n; ++i )
+		for( uint64_t k = A->row_start[ i ]; k < A->row_start[ i + 1 ]; ++k )
+			T->node[ T->start[ A->col[ k ] ]++ ] = i;
+	for( size_t j = A->n; j > 0; --j )
+		T->start[ j ] = T->start[ j - 1 ];
+	T->start[ 0 ] = 0;
+	return 0;
+}
+
+void csr_pattern_free( struct csr_pattern *T ) {
+	free( T->start );
+	free( T->node );
+	T->start = NULL;
+	T->node = NULL;
+}
@@ -0,0 +1,38 @@
+#ifndef _H_CSR
+#define _H_CSR
+
+#include <stddef.h>
+#include <stdint.h>
+
+//transition matrix in compressed sparse row format: the nonzeros of row i are
+//col[row_start[i]] .. col[row_start[i+1]-1] with values val[...]. A row holds
+//the in-links of node i, so y = A x is one step of the power method.
+struct csr {
+	size_t n;
+	size_t nnz;
+	uint64_t *row_start;
+	uint32_t *col;
+	double *val;
+};
+
+//allocates an n x n matrix with room for nnz nonzeros, returns 0 on success
+int csr_alloc( struct csr *A, size_t n, size_t nnz );
+
+//builds a CSR matrix from a row-major dense n x n array, skipping zeros
+int csr_from_dense( struct csr *A, size_t n, const double *dense );
+
+void csr_free( struct csr *A );
+
+//the pattern of the transpose: the rows holding a nonzero in column j, that
+//is the out-links of node j, are node[start[j]] .. node[start[j+1]-1]
+struct csr_pattern {
+	uint64_t *start;
+	uint32_t *node;
+};
+
+//builds the transposed pattern of A, returns 0 on success
+int csr_transpose_pattern( const struct csr *A, struct csr_pattern *T );
+
+void csr_pattern_free( struct csr_pattern *T );
+
+#endif
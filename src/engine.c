@@ -0,0 +1,1270 @@
+#include "engine.h"
+#include "arena.h"
+#include "checkpoint.h"
+#include "numa.h"
+#include "partition.h"
+#include "plan.h"
+#include "steal.h"
+#include "trace.h"
+
+#include <mcbsp.h>
+#include <mcbsp-affinity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//damping factor of the current run
+static double fudge_factor;
+
+//state shared between pagerank_run and the SPMD section
+static const struct graph *graph;
+static const struct engine_config *config;
+static double *rank;
+//processor s owns the rows and vector entries [starts[s], starts[s+1])
+static size_t *starts;
+//1D rows split over the processors that own their columns: a flag per row,
+//NULL if none is split, and the ascending list of them
+static unsigned char *heavy;
+static uint32_t *heavy_rows;
+static size_t nheavy;
+//the 2D distribution places processor s at grid row s / grid_cols and grid
+//column s % grid_cols
+static unsigned int grid_rows, grid_cols;
+static struct engine_stats *proc_stats;
+//the work of every processor, as balanced by the default distribution
+static size_t *proc_work;
+//per-processor timing and traffic of the iteration
+static struct trace *traces;
+//the chunk deques of all processors when work stealing is on, else NULL
+static struct steal_queue *queues;
+//NUMA mode, per processor: its node (-1 if not pinned), its local matrix
+//values, and the read bandwidth it measured over them and over those of a
+//processor on remote_node
+struct placement {
+	int node, remote_node;
+	const double *val;
+	size_t nnz;
+	double local_bandwidth, remote_bandwidth;
+};
+static struct placement *placements;
+static unsigned int numa_nodes;
+//NUMA mode without pinning: the node that has too few cores
+static int numa_short_node;
+//the sparse matrix-vector kernels chosen for this machine
+static spmv_kernel spmv;
+static spmm_kernel spmm;
+//the personalization vectors of a batched run
+static unsigned int batch_width;
+static const struct personalization *batch_vectors;
+
+//iterates kept for extrapolation, and how often it is tried
+#define ACCEL_ITERATES 4
+#define ACCEL_PERIOD 10
+//iterations a node must stay under the adaptive threshold to be frozen
+#define ADAPTIVE_WINDOW 2
+
+//the part of the matrix and vector a processor works on. Local vector
+//indices 0..nown-1 are the owned entries lo..hi-1, the entries after that are
+//copies (ghosts) of the remote entries the local nonzeros refer to.
+struct local {
+	size_t lo, hi, nown;
+	size_t nghost;
+	//global ids of the ghosts, ascending and therefore grouped by owner
+	uint32_t *ghost;
+	//rows holding local nonzeros. In 1D these are the owned rows and row is
+	//NULL; in 2D row lists their ascending global ids, which may belong to
+	//any processor in the same grid row.
+	size_t nrows;
+	uint32_t *row;
+	//in 1D row offsets and values are read from the shared matrix and only
+	//the column indices are renumbered into the local vector; in 2D, and in
+	//NUMA mode, the local nonzeros are copied out and row_start/val point to
+	//the copies
+	const uint64_t *row_start;
+	uint64_t base;
+	const double *val;
+	uint32_t *col;
+	uint64_t *copy_row_start;
+	double *copy_val;
+	//owned nodes whose column does not sum to one, as global ids, and the
+	//share of their rank that leaves the matrix (NULL: all of it)
+	const uint32_t *dangling;
+	const double *deficit;
+	size_t ndangling;
+	//owned seed nodes of the personalization vector and their weights
+	const uint32_t *seed;
+	const double *seed_weight;
+	size_t nseeds;
+};
+
+static int compare_uint32( const void *a, const void *b ) {
+	const uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+//first index in the sorted array a[0..n) whose value is not below key
+static size_t lower_bound( const uint32_t *a, size_t n, uint32_t key ) {
+	size_t lo = 0;
+	while( n > 0 ) {
+		const size_t half = n / 2;
+		if( a[ lo + half ] < key ) {
+			lo += half + 1;
+			n -= half + 1;
+		} else {
+			n = half;
+		}
+	}
+	return lo;
+}
+
+static unsigned int owner_of( size_t i ) {
+	unsigned int lo = 0, hi = bsp_nprocs();
+	while( hi - lo > 1 ) {
+		const unsigned int mid = (lo + hi) / 2;
+		if( starts[ mid ] <= i )
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+//collects the remote columns among nnz global column indices and renumbers
+//them into L->col; global may be L->col itself
+static int renumber_columns( struct local *L, struct arena *arena, const uint32_t *global, size_t nnz ) {
+	uint32_t *remote = malloc( (nnz ? nnz : 1) * sizeof(uint32_t) );
+	if( remote == NULL )
+		return -1;
+	size_t r = 0;
+	for( size_t k = 0; k < nnz; ++k ) {
+		const uint32_t c = global[ k ];
+		if( c < L->lo || c >= L->hi )
+			remote[ r++ ] = c;
+	}
+	qsort( remote, r, sizeof(uint32_t), compare_uint32 );
+	L->nghost = 0;
+	for( size_t k = 0; k < r; ++k )
+		if( L->nghost == 0 || remote[ k ] != remote[ L->nghost - 1 ] )
+			remote[ L->nghost++ ] = remote[ k ];
+	L->ghost = arena_alloc( arena, L->nghost * sizeof(uint32_t) );
+	memcpy( L->ghost, remote, L->nghost * sizeof(uint32_t) );
+	free( remote );
+
+	for( size_t k = 0; k < nnz; ++k ) {
+		const uint32_t c = global[ k ];
+		if( c >= L->lo && c < L->hi )
+			L->col[ k ] = c - L->lo;
+		else
+			L->col[ k ] = L->nown + lower_bound( L->ghost, L->nghost, c );
+	}
+	return 0;
+}
+
+static void local_owned( struct local *L, unsigned int s ) {
+	memset( L, 0, sizeof(*L) );
+	L->lo = starts[ s ];
+	L->hi = starts[ s + 1 ];
+	L->nown = L->hi - L->lo;
+	const size_t first = lower_bound( graph->dangling, graph->ndangling, L->lo );
+	L->dangling = graph->dangling + first;
+	L->deficit = graph->deficit != NULL ? graph->deficit + first : NULL;
+	L->ndangling = lower_bound( graph->dangling, graph->ndangling, L->hi ) - first;
+	const struct personalization *v = config->personalization;
+	if( v != NULL ) {
+		const size_t first_seed = lower_bound( v->node, v->count, L->lo );
+		L->seed = v->node + first_seed;
+		L->seed_weight = v->weight + first_seed;
+		L->nseeds = lower_bound( v->node, v->count, L->hi ) - first_seed;
+	}
+}
+
+//1D: the local nonzeros are the owned rows
+static int local_init( struct local *L, struct arena *arena, unsigned int s ) {
+	const struct csr *A = &graph->A;
+	local_owned( L, s );
+	L->nrows = L->nown;
+	L->row_start = A->row_start + L->lo;
+	L->base = A->row_start[ L->lo ];
+	L->val = A->val + L->base;
+	const size_t nnz = A->row_start[ L->hi ] - L->base;
+	L->col = arena_alloc( arena, nnz * sizeof(uint32_t) );
+	if( config->numa ) {
+		//first touched here, so placed on this processor's node
+		L->copy_row_start = arena_alloc( arena, (L->nrows + 1) * sizeof(uint64_t) );
+		L->copy_val = arena_alloc( arena, nnz * sizeof(double) );
+		memcpy( L->copy_row_start, L->row_start, (L->nrows + 1) * sizeof(uint64_t) );
+		memcpy( L->copy_val, L->val, nnz * sizeof(double) );
+		L->row_start = L->copy_row_start;
+		L->val = L->copy_val;
+	}
+	return renumber_columns( L, arena, A->col + L->base, nnz );
+}
+
+//2D: processor (a,b) takes the nonzeros (i,j) whose row i is owned within
+//grid row a and whose column j is owned within grid column b
+static int local_init_2d( struct local *L, struct arena *arena, unsigned int s ) {
+	const struct csr *A = &graph->A;
+	const unsigned int a = s / grid_cols, b = s % grid_cols;
+	const size_t first_row = starts[ a * grid_cols ], end_row = starts[ (a + 1) * grid_cols ];
+	local_owned( L, s );
+
+	size_t nnz = 0;
+	for( size_t i = first_row; i < end_row; ++i ) {
+		int any = 0;
+		for( uint64_t k = A->row_start[ i ]; k < A->row_start[ i + 1 ]; ++k ) {
+			if( owner_of( A->col[ k ] ) % grid_cols == b ) {
+				++nnz;
+				any = 1;
+			}
+		}
+		L->nrows += any;
+	}
+	L->row = arena_alloc( arena, L->nrows * sizeof(uint32_t) );
+	L->copy_row_start = arena_alloc( arena, (L->nrows + 1) * sizeof(uint64_t) );
+	L->copy_val = arena_alloc( arena, nnz * sizeof(double) );
+	L->col = arena_alloc( arena, nnz * sizeof(uint32_t) );
+
+	size_t r = 0, k = 0;
+	L->copy_row_start[ 0 ] = 0;
+	for( size_t i = first_row; i < end_row; ++i ) {
+		for( uint64_t t = A->row_start[ i ]; t < A->row_start[ i + 1 ]; ++t ) {
+			if( owner_of( A->col[ t ] ) % grid_cols == b ) {
+				L->col[ k ] = A->col[ t ];
+				L->copy_val[ k ] = A->val[ t ];
+				++k;
+			}
+		}
+		if( k > L->copy_row_start[ r ] ) {
+			L->row[ r ] = i;
+			L->copy_row_start[ ++r ] = k;
+		}
+	}
+	L->row_start = L->copy_row_start;
+	L->base = 0;
+	L->val = L->copy_val;
+	return renumber_columns( L, arena, L->col, nnz );
+}
+
+//the nonzeros of row i that processor s computes, copied out if col is not
+//NULL: all of them, or for a split row those whose column s owns
+static size_t row_share( size_t i, unsigned int s, uint32_t *col, double *val ) {
+	const struct csr *A = &graph->A;
+	size_t k = 0;
+	for( uint64_t t = A->row_start[ i ]; t < A->row_start[ i + 1 ]; ++t ) {
+		if( heavy[ i ] && owner_of( A->col[ t ] ) != s )
+			continue;
+		if( col != NULL ) {
+			col[ k ] = A->col[ t ];
+			val[ k ] = A->val[ t ];
+		}
+		++k;
+	}
+	return k;
+}
+
+//1D with split rows: the owned rows, in ascending order with the split rows
+//of other processors, which come before lo or from hi on
+static size_t split_row( const struct local *L, size_t before, size_t after, size_t c ) {
+	if( c < before )
+		return heavy_rows[ c ];
+	c -= before;
+	return c < L->nown ? L->lo + c : heavy_rows[ after + c - L->nown ];
+}
+
+//1D with split rows: the local nonzeros are copied out as in 2D, and the
+//partial sums of other processors' split rows go to their owners
+static int local_init_split( struct local *L, struct arena *arena, unsigned int s ) {
+	local_owned( L, s );
+	const size_t before = lower_bound( heavy_rows, nheavy, L->lo );
+	const size_t after = lower_bound( heavy_rows, nheavy, L->hi );
+	const size_t ncandidates = before + L->nown + nheavy - after;
+
+	size_t nnz = 0;
+	for( size_t c = 0; c < ncandidates; ++c ) {
+		const size_t k = row_share( split_row( L, before, after, c ), s, NULL, NULL );
+		nnz += k;
+		L->nrows += k > 0;
+	}
+	L->row = arena_alloc( arena, L->nrows * sizeof(uint32_t) );
+	L->copy_row_start = arena_alloc( arena, (L->nrows + 1) * sizeof(uint64_t) );
+	L->copy_val = arena_alloc( arena, nnz * sizeof(double) );
+	L->col = arena_alloc( arena, nnz * sizeof(uint32_t) );
+
+	size_t r = 0, k = 0;
+	L->copy_row_start[ 0 ] = 0;
+	for( size_t c = 0; c < ncandidates; ++c ) {
+		const size_t i = split_row( L, before, after, c );
+		k += row_share( i, s, L->col + k, L->copy_val + k );
+		if( k > L->copy_row_start[ r ] ) {
+			L->row[ r ] = i;
+			L->copy_row_start[ ++r ] = k;
+		}
+	}
+	L->row_start = L->copy_row_start;
+	L->base = 0;
+	L->val = L->copy_val;
+	return renumber_columns( L, arena, L->col, nnz );
+}
+
+//the local part of the matrix for the configured distribution
+static int local_setup( struct local *L, struct arena *arena, unsigned int s ) {
+	if( config->distribution == DIST_2D )
+		return local_init_2d( L, arena, s );
+	return heavy != NULL ? local_init_split( L, arena, s ) : local_init( L, arena, s );
+}
+
+//computes the local partial sum of every local row, damped once per row, for
+//width interleaved vectors; with work stealing other processors may compute
+//some of the rows
+static void multiply( const struct local *L, const double *x, double *partial, unsigned int width ) {
+	if( queues != NULL )
+		steal_multiply( queues, bsp_nprocs(), bsp_pid(), spmv, spmm, fudge_factor, x, partial, width );
+	else if( width == 1 )
+		spmv( L->nrows, L->row_start, L->col, L->val, x, fudge_factor, partial );
+	else
+		spmm( L->nrows, L->row_start, L->col, L->val, x, width, fudge_factor, partial );
+}
+
+//adds the difference between a new and an old entry to the local residual
+static double accumulate( double alpha, double new, double old ) {
+	const double d = new > old ? new - old : old - new;
+	if( config->norm == NORM_L1 )
+		return alpha + d;
+	return d > alpha ? d : alpha;
+}
+
+//adaptive mode (1D only): the owned rows still being computed, as ascending
+//local indices, and per owned row for how many iterations in a row its entry
+//has changed by at most eps. A row that stays calm for ADAPTIVE_WINDOW
+//iterations is frozen: its entry keeps its last value. What the entries it
+//reads and its share of the teleported rank have moved since is added up
+//into its drift, a bound on how much computing the row would change it; the
+//row is computed again once that exceeds eps. Many drifts below eps can
+//still add up to more than the tolerance, so once the computed rows alone
+//have converged every frozen row that drifted at all is computed again.
+struct active {
+	uint32_t *row;
+	size_t nrows;
+	unsigned char *calm;
+	double *drift;
+	//the local transpose: the rows reading local vector entry j, with their
+	//nonzeros, are reader[reader_start[j] .. reader_start[j+1])
+	uint64_t *reader_start;
+	uint32_t *reader;
+	double *reader_val;
+	//per local vector entry its change since the last update, and the
+	//ghosts as of then
+	double *delta;
+	double *ghost;
+	//the teleported rank as of the last update
+	double teleport;
+	double eps;
+};
+
+static void active_init( struct active *A, struct arena *arena, const struct local *L ) {
+	const size_t length = L->nown + L->nghost;
+	const uint64_t nnz = L->row_start[ L->nown ] - L->base;
+	A->row = arena_alloc( arena, L->nown * sizeof(uint32_t) );
+	A->calm = arena_alloc( arena, L->nown );
+	A->drift = arena_alloc( arena, L->nown * sizeof(double) );
+	A->reader_start = arena_alloc( arena, (length + 1) * sizeof(uint64_t) );
+	A->reader = arena_alloc( arena, (nnz + 1) * sizeof(uint32_t) );
+	A->reader_val = arena_alloc( arena, (nnz + 1) * sizeof(double) );
+	A->delta = arena_alloc( arena, length * sizeof(double) );
+	A->ghost = arena_alloc( arena, (L->nghost + 1) * sizeof(double) );
+	A->nrows = L->nown;
+	for( size_t r = 0; r < L->nown; ++r )
+		A->row[ r ] = r;
+	memset( A->calm, 0, L->nown );
+	memset( A->drift, 0, L->nown * sizeof(double) );
+	memset( A->delta, 0, length * sizeof(double) );
+	memset( A->ghost, 0, L->nghost * sizeof(double) );
+	A->teleport = 0.0;
+	//with the 1-norm the residual adds up the changes of all n entries
+	A->eps = config->adaptive_threshold * config->tolerance / (config->norm == NORM_L1 ? graph->A.n : 1);
+	memset( A->reader_start, 0, (length + 1) * sizeof(uint64_t) );
+	for( uint64_t k = 0; k < nnz; ++k )
+		++A->reader_start[ L->col[ k ] + 1 ];
+	for( size_t j = 0; j < length; ++j )
+		A->reader_start[ j + 1 ] += A->reader_start[ j ];
+	for( size_t r = 0; r < L->nown; ++r ) {
+		for( uint64_t k = L->row_start[ r ] - L->base; k < L->row_start[ r + 1 ] - L->base; ++k ) {
+			const uint64_t to = A->reader_start[ L->col[ k ] ]++;
+			A->reader[ to ] = r;
+			A->reader_val[ to ] = L->val[ k ];
+		}
+	}
+	for( size_t j = length; j > 0; --j )
+		A->reader_start[ j ] = A->reader_start[ j - 1 ];
+	A->reader_start[ 0 ] = 0;
+}
+
+//records the change of owned entry r, just computed
+static void active_settle( struct active *A, size_t r, double new, double old ) {
+	const double d = new > old ? new - old : old - new;
+	A->delta[ r ] = new - old;
+	A->drift[ r ] = 0.0;
+	if( d > A->eps )
+		A->calm[ r ] = 0;
+	else if( A->calm[ r ] < ADAPTIVE_WINDOW )
+		++A->calm[ r ];
+}
+
+//adds what the entries moved since the last update, teleport being the rank
+//teleported in the coming iteration, to the drift of the frozen rows, wakes
+//those that drifted too far, or with flush all that drifted, and lists the
+//rows to compute next. Returns the residual the frozen rows contribute: the
+//bound on their change.
+static double active_update( struct active *A, const struct local *L, const double *x, double teleport, int flush ) {
+	for( size_t g = 0; g < L->nghost; ++g ) {
+		A->delta[ L->nown + g ] = x[ L->nown + g ] - A->ghost[ g ];
+		A->ghost[ g ] = x[ L->nown + g ];
+	}
+	const double shift = teleport > A->teleport ? teleport - A->teleport : A->teleport - teleport;
+	A->teleport = teleport;
+	//the change of an entry only matters to the frozen rows reading it,
+	//including those frozen by the iteration just done. They are reached
+	//from the entries that moved through the transpose, or, if their
+	//nonzeros are fewer, by walking the frozen rows themselves.
+	size_t frozen = 0;
+	uint64_t frozen_nnz = 0;
+	for( size_t r = 0; r < L->nown; ++r ) {
+		if( A->calm[ r ] >= ADAPTIVE_WINDOW ) {
+			++frozen;
+			frozen_nnz += L->row_start[ r + 1 ] - L->row_start[ r ];
+		}
+	}
+	if( frozen > 0 ) {
+		uint64_t readers = 0;
+		for( size_t j = 0; j < L->nown + L->nghost; ++j )
+			if( A->delta[ j ] != 0.0 )
+				readers += A->reader_start[ j + 1 ] - A->reader_start[ j ];
+		if( readers <= frozen_nnz ) {
+			for( size_t j = 0; j < L->nown + L->nghost; ++j ) {
+				if( A->delta[ j ] == 0.0 )
+					continue;
+				const double d = fudge_factor * (A->delta[ j ] > 0.0 ? A->delta[ j ] : -A->delta[ j ]);
+				for( uint64_t k = A->reader_start[ j ]; k < A->reader_start[ j + 1 ]; ++k )
+					if( A->calm[ A->reader[ k ] ] >= ADAPTIVE_WINDOW )
+						A->drift[ A->reader[ k ] ] += A->reader_val[ k ] * d;
+			}
+		} else {
+			for( size_t r = 0; r < L->nown; ++r ) {
+				if( A->calm[ r ] < ADAPTIVE_WINDOW )
+					continue;
+				double d = 0.0;
+				for( uint64_t k = L->row_start[ r ] - L->base; k < L->row_start[ r + 1 ] - L->base; ++k ) {
+					const double change = A->delta[ L->col[ k ] ];
+					d += L->val[ k ] * (change > 0.0 ? change : -change);
+				}
+				A->drift[ r ] += fudge_factor * d;
+			}
+		}
+		for( size_t k = 0; k < L->nseeds && config->personalization != NULL; ++k )
+			A->drift[ L->seed[ k ] - L->lo ] += shift * L->seed_weight[ k ];
+	}
+	memset( A->delta, 0, (L->nown + L->nghost) * sizeof(double) );
+	double alpha = 0.0;
+	A->nrows = 0;
+	for( size_t r = 0; r < L->nown; ++r ) {
+		if( A->calm[ r ] >= ADAPTIVE_WINDOW ) {
+			if( config->personalization == NULL )
+				A->drift[ r ] += shift / graph->A.n;
+			//one calm iteration freezes a woken row again
+			if( A->drift[ r ] > A->eps || (flush && A->drift[ r ] > 0.0) )
+				A->calm[ r ] = ADAPTIVE_WINDOW - 1;
+		}
+		if( A->calm[ r ] < ADAPTIVE_WINDOW )
+			A->row[ A->nrows++ ] = r;
+		else
+			alpha = accumulate( alpha, A->drift[ r ], 0.0 );
+	}
+	return alpha;
+}
+
+//computes the partial sums of the active rows, with one kernel call per run
+//of consecutive rows; with work stealing the chunks are cut over the active
+//rows only, so processors with few of them left help the others
+static void multiply_active( const struct local *L, const struct active *A, const double *x, double *partial ) {
+	if( queues != NULL ) {
+		steal_multiply_rows( queues, bsp_nprocs(), bsp_pid(), spmv, spmm, fudge_factor, A->row, A->nrows, x, partial );
+		return;
+	}
+	for( size_t a = 0, b; a < A->nrows; a = b ) {
+		for( b = a + 1; b < A->nrows && A->row[ b ] == A->row[ b - 1 ] + 1; ++b )
+			;
+		const uint32_t r = A->row[ a ];
+		const uint64_t k = L->row_start[ r ] - L->base;
+		spmv( b - a, L->row_start + r, L->col + k, L->val + k, x, fudge_factor, partial + r );
+	}
+}
+
+//the rank teleported in one step, c in total, goes uniformly to all nodes or,
+//with a personalization vector, to its seed nodes only. This adds it to the
+//owned entries of y.
+static void add_teleport( const struct local *L, double *y, double c ) {
+	if( config->personalization == NULL ) {
+		for( size_t i = 0; i < L->nown; ++i )
+			y[ i ] += c / graph->A.n;
+		return;
+	}
+	for( size_t k = 0; k < L->nseeds; ++k )
+		y[ L->seed[ k ] - L->lo ] += c * L->seed_weight[ k ];
+}
+
+//the same for the single owned entry r. Entries must be visited in ascending
+//order, with *cursor 0 before the first.
+static double row_teleport( const struct local *L, size_t *cursor, size_t r, double c ) {
+	if( config->personalization == NULL )
+		return c / graph->A.n;
+	while( *cursor < L->nseeds && L->seed[ *cursor ] < L->lo + r )
+		++*cursor;
+	if( *cursor < L->nseeds && L->seed[ *cursor ] == L->lo + r )
+		return c * L->seed_weight[ *cursor ];
+	return 0.0;
+}
+
+//Gauss-Seidel (1D only): updates the owned entries of x in place, so each row
+//already sees the new values of the owned rows before it. Ghosts keep the
+//values of the last superstep. Only the active rows are swept if A is given.
+//Every row depends on the one before, so the row products are computed here
+//rather than by a kernel call per row. Returns the local residual.
+static double sweep( const struct local *L, struct active *A, double *x, double teleport ) {
+	double alpha = 0.0;
+	size_t cursor = 0;
+	const size_t nrows = A ? A->nrows : L->nrows;
+	for( size_t a = 0; a < nrows; ++a ) {
+		const size_t r = A ? A->row[ a ] : a;
+		double sum = 0.0;
+		for( uint64_t k = L->row_start[ r ] - L->base; k < L->row_start[ r + 1 ] - L->base; ++k )
+			sum += L->val[ k ] * x[ L->col[ k ] ];
+		const double next = fudge_factor * sum + row_teleport( L, &cursor, r, teleport );
+		alpha = accumulate( alpha, next, x[ r ] );
+		if( A )
+			active_settle( A, r, next, x[ r ] );
+		x[ r ] = next;
+	}
+	return alpha;
+}
+
+//fan-out: every ghost is received from its owner
+static void plan_fanout( const struct local *L, struct arena *arena, struct comm_plan *plan, unsigned int width ) {
+	struct plan_entry *entries = malloc( (L->nghost + 1) * sizeof(struct plan_entry) );
+	if( entries == NULL )
+		bsp_abort( "Processor %u: out of memory\n", bsp_pid() );
+	for( size_t g = 0; g < L->nghost; ++g ) {
+		entries[ g ].peer = owner_of( L->ghost[ g ] );
+		entries[ g ].remote = L->ghost[ g ] - starts[ entries[ g ].peer ];
+		entries[ g ].local = L->nown + g;
+	}
+	plan_build( plan, arena, PLAN_PULL, entries, L->nghost, width );
+	free( entries );
+}
+
+//fan-in: the partial sums of rows owned by other processors, of the grid row
+//in 2D, are sent to, and added up by, those owners
+static void plan_fanin( const struct local *L, struct arena *arena, struct comm_plan *plan, unsigned int width ) {
+	struct plan_entry *entries = malloc( (L->nrows + 1) * sizeof(struct plan_entry) );
+	if( entries == NULL )
+		bsp_abort( "Processor %u: out of memory\n", bsp_pid() );
+	size_t n = 0;
+	for( size_t r = 0; r < L->nrows; ++r ) {
+		if( L->row[ r ] >= L->lo && L->row[ r ] < L->hi )
+			continue;
+		entries[ n ].peer = owner_of( L->row[ r ] );
+		entries[ n ].remote = L->row[ r ] - starts[ entries[ n ].peer ];
+		entries[ n ].local = r;
+		++n;
+	}
+	plan_build( plan, arena, PLAN_PUSH, entries, n, width );
+	free( entries );
+}
+
+//fan-in: the own partial sums of owned rows, to which it adds the rest;
+//width is the number of interleaved vectors
+static void own_partials( const struct local *L, const double *partial, double *y, unsigned int width ) {
+	memset( y, 0, L->nown * width * sizeof(double) );
+	for( size_t r = 0; r < L->nrows; ++r )
+		if( L->row[ r ] >= L->lo && L->row[ r ] < L->hi )
+			memcpy( y + (L->row[ r ] - L->lo) * width, partial + r * width, width * sizeof(double) );
+}
+
+//the values every processor contributes to the reduction of a superstep
+struct reduction {
+	double residual;
+	//in adaptive mode the residual also holds the bound on the change of the
+	//frozen rows; this is the part of the rows actually computed
+	double computed;
+	//rank that leaves the matrix: all of a dangling node's, and what a column
+	//summing to less than one loses
+	double dangling;
+	//total rank of the owned entries
+	double mass;
+	//inner products of the differences used for extrapolation
+	double gram[ 6 ];
+};
+
+//sends this processor's contribution to every processor
+static void share( struct reduction *reduce_buffer, const struct reduction *mine ) {
+	for( unsigned int k = 0; k < bsp_nprocs(); ++k ) {
+		bsp_put( k, mine, reduce_buffer, bsp_pid()*sizeof(struct reduction), sizeof(struct reduction) );
+	}
+}
+
+//combines the contributions put into the reduction buffer during the last
+//sync: the residual is summed for the L1 norm and maximised for the infinity
+//norm, the other values are summed. Every thread combines the same values in
+//the same order, so all see the same result.
+static void reduce( const struct reduction *reduce_buffer, struct reduction *total ) {
+	*total = reduce_buffer[ 0 ];
+	for( unsigned int k = 1; k < bsp_nprocs(); ++k ) {
+		if( config->norm == NORM_L1 )
+			total->residual += reduce_buffer[ k ].residual;
+		else if( reduce_buffer[ k ].residual > total->residual )
+			total->residual = reduce_buffer[ k ].residual;
+		if( config->norm == NORM_L1 )
+			total->computed += reduce_buffer[ k ].computed;
+		else if( reduce_buffer[ k ].computed > total->computed )
+			total->computed = reduce_buffer[ k ].computed;
+		total->dangling += reduce_buffer[ k ].dangling;
+		total->mass += reduce_buffer[ k ].mass;
+		for( unsigned int g = 0; g < 6; ++g )
+			total->gram[ g ] += reduce_buffer[ k ].gram[ g ];
+	}
+}
+
+//this processor's contribution for the owned entries of x, of which the
+//computed rows changed by residual and the frozen ones by at most frozen
+static void local_reduction( const struct local *L, const double *x, double residual, double frozen, struct reduction *mine ) {
+	mine->residual = accumulate( residual, frozen, 0.0 );
+	mine->computed = residual;
+	mine->dangling = 0.0;
+	for( size_t k = 0; k < L->ndangling; ++k )
+		mine->dangling += (L->deficit != NULL ? L->deficit[ k ] : 1.0) * x[ L->dangling[ k ] - L->lo ];
+	mine->mass = 0.0;
+	for( size_t i = 0; i < L->nown; ++i )
+		mine->mass += x[ i ];
+	memset( mine->gram, 0, sizeof(mine->gram) );
+}
+
+//the last iterates, kept for extrapolation: iterate k is stored in slot
+//k % ACCEL_ITERATES together with its dangling rank and total rank
+struct history {
+	double *x[ ACCEL_ITERATES ];
+	double dangling[ ACCEL_ITERATES ];
+	double mass[ ACCEL_ITERATES ];
+	//consecutive iterates stored since the start or the last extrapolation
+	unsigned int count;
+};
+
+static void history_store( struct history *H, unsigned int k, const double *x, size_t length, const struct reduction *total ) {
+	const unsigned int slot = k % ACCEL_ITERATES;
+	memcpy( H->x[ slot ], x, length * sizeof(double) );
+	H->dangling[ slot ] = total->dangling;
+	H->mass[ slot ] = total->mass;
+	++H->count;
+}
+
+//local part of the Gram matrix of y_i = x_{k-3+i} - x_{k-3}, i = 1, 2, 3,
+//where x holds iterate k: gram = { y1.y1, y1.y2, y1.y3, y2.y2, y2.y3, y3.y3 }
+static void history_gram( const struct history *H, unsigned int k, const double *x, size_t nown, double *gram ) {
+	const double *x0 = H->x[ (k - 3) % ACCEL_ITERATES ];
+	const double *x1 = H->x[ (k - 2) % ACCEL_ITERATES ];
+	const double *x2 = H->x[ (k - 1) % ACCEL_ITERATES ];
+	for( size_t i = 0; i < nown; ++i ) {
+		const double y1 = x1[ i ] - x0[ i ], y2 = x2[ i ] - x0[ i ], y3 = x[ i ] - x0[ i ];
+		gram[ 0 ] += y1 * y1;
+		gram[ 1 ] += y1 * y2;
+		gram[ 2 ] += y1 * y3;
+		gram[ 3 ] += y2 * y2;
+		gram[ 4 ] += y2 * y3;
+		gram[ 5 ] += y3 * y3;
+	}
+}
+
+//the weights of iterates k-2, k-1 and k in the extrapolated vector, from the
+//global Gram matrix. Returns 0 when the iterates do not allow a stable
+//extrapolation, in which case the iteration just carries on.
+static int extrapolation_weights( const double *gram, double *beta ) {
+	if( config->accel == ACCEL_AITKEN ) {
+		//vector Aitken: the ratio lambda of successive differences d_k =
+		//x_k - x_{k-1} estimates the dominant error decay, whose geometric
+		//tail is summed in one step: x_k + lambda/(1-lambda) d_k
+		const double num = gram[ 4 ] - gram[ 2 ] - gram[ 3 ] + gram[ 1 ];
+		const double den = gram[ 3 ] - 2.0 * gram[ 1 ] + gram[ 0 ];
+		if( !(den > 0.0) )
+			return 0;
+		const double lambda = num / den;
+		if( !(lambda > 0.0 && lambda < 1.0) )
+			return 0;
+		const double c = lambda / (1.0 - lambda);
+		beta[ 0 ] = 0.0;
+		beta[ 1 ] = -c;
+		beta[ 2 ] = 1.0 + c;
+		return 1;
+	}
+	//quadratic extrapolation (Kamvar et al.): the least-squares gamma with
+	//gamma_3 = 1 and gamma_1 y1 + gamma_2 y2 = -y3 gives the coefficients of
+	//the minimal polynomial of the error over three eigenvectors
+	const double det = gram[ 0 ] * gram[ 3 ] - gram[ 1 ] * gram[ 1 ];
+	if( !(det > 1e-12 * gram[ 0 ] * gram[ 3 ]) )
+		return 0;
+	const double g1 = (-gram[ 2 ] * gram[ 3 ] + gram[ 1 ] * gram[ 4 ]) / det;
+	const double g2 = (-gram[ 0 ] * gram[ 4 ] + gram[ 1 ] * gram[ 2 ]) / det;
+	beta[ 0 ] = g1 + g2 + 1.0;
+	beta[ 1 ] = g2 + 1.0;
+	beta[ 2 ] = 1.0;
+	const double sum = beta[ 0 ] + beta[ 1 ] + beta[ 2 ];
+	if( !(sum > 1e-3 || sum < -1e-3) )
+		return 0;
+	for( unsigned int t = 0; t < 3; ++t )
+		beta[ t ] /= sum;
+	return 1;
+}
+
+//replaces iterate k in x, ghosts included, by the weighted combination of
+//iterates k-2, k-1 and k; the weights sum to one, so a fixed point is kept
+static void extrapolate( const struct history *H, unsigned int k, const double *beta, double *x, size_t length, struct reduction *total ) {
+	const unsigned int s0 = (k - 2) % ACCEL_ITERATES, s1 = (k - 1) % ACCEL_ITERATES;
+	const double *x0 = H->x[ s0 ], *x1 = H->x[ s1 ];
+	for( size_t i = 0; i < length; ++i )
+		x[ i ] = beta[ 0 ] * x0[ i ] + beta[ 1 ] * x1[ i ] + beta[ 2 ] * x[ i ];
+	total->dangling = beta[ 0 ] * H->dangling[ s0 ] + beta[ 1 ] * H->dangling[ s1 ] + beta[ 2 ] * total->dangling;
+	total->mass = beta[ 0 ] * H->mass[ s0 ] + beta[ 1 ] * H->mass[ s1 ] + beta[ 2 ] * total->mass;
+}
+
+//NUMA mode: every processor reads its own matrix values, then, all at the
+//same time, those of a processor on another node if there is one
+static void probe_bandwidth( const struct local *L, unsigned int s ) {
+	const unsigned int P = bsp_nprocs();
+	struct placement *mine = placements + s;
+	mine->val = L->val;
+	mine->nnz = L->row_start[ L->nrows ] - L->base;
+	bsp_sync();
+	mine->local_bandwidth = numa_read_bandwidth( mine->val, mine->nnz );
+	//the first processor from halfway round that sits on another node
+	unsigned int t = (s + P / 2) % P;
+	for( unsigned int k = 0; k < P && placements[ t ].node == mine->node; ++k )
+		t = (t + 1) % P;
+	mine->remote_node = placements[ t ].node;
+	bsp_sync();
+	mine->remote_bandwidth = t != s ? numa_read_bandwidth( placements[ t ].val, placements[ t ].nnz ) : 0.0;
+	bsp_sync();
+}
+
+//the whole power method runs inside one SPMD section. Every processor owns a
+//block of the vector and computes that block of the next vector. Which remote
+//entries each processor needs never changes, so it is worked out once into a
+//communication plan; per iteration every owner then sends exactly those
+//entries, packed into one message per peer, in the same sync that combines
+//the residual. With the 1D distribution a processor holds the matching rows
+//and computes its block outright; in 2D it holds a checkerboard block of
+//nonzeros and an extra sync first delivers the partial row sums to their
+//owners; split 1D rows take the same way. The Gauss-Seidel solver replaces
+//the product by an in-place sweep over the owned rows. With acceleration
+//every processor also keeps its last iterates, ghosts included, and every
+//ACCEL_PERIOD iterations the regular reduction carries the inner products
+//from which all processors extrapolate the same way without an extra
+//superstep. In adaptive mode a processor only recomputes the rows that have
+//not settled yet, or whose inputs have moved since. With work stealing,
+//processors that finish their part of the product early compute chunks of the
+//others' within the same superstep. Checkpoints are written by a background
+//thread per processor while the iteration goes on. Everything a processor
+//uses is taken from its arena during setup and given back in one go at the
+//end.
+void spmd() {
+	bsp_begin( config->nprocs );
+	const unsigned int s = bsp_pid();
+	//whether partial row sums go to their owners in an extra superstep
+	const int fan_in = config->distribution == DIST_2D || heavy != NULL;
+	struct arena arena;
+	arena_init( &arena );
+	struct local L;
+	if( local_setup( &L, &arena, s ) != 0 )
+		bsp_abort( "Processor %u: out of memory\n", s );
+	double *x = arena_alloc( &arena, (L.nown + L.nghost) * sizeof(double) );
+	double *y = arena_alloc( &arena, L.nown * sizeof(double) );
+	double *partial = fan_in ? arena_alloc( &arena, L.nrows * sizeof(double) ) : y;
+	struct reduction *reduce_buffer = arena_alloc_registered( &arena, bsp_nprocs() * sizeof(struct reduction) );
+	struct comm_plan fanout, fanin;
+	memset( &fanin, 0, sizeof(fanin) );
+	plan_fanout( &L, &arena, &fanout, 1 );
+	if( queues != NULL )
+		steal_init( queues + s, &arena, L.nrows, L.row_start, L.base, L.col, L.val, config->chunks );
+	if( placements != NULL )
+		probe_bandwidth( &L, s );
+	if( fan_in )
+		plan_fanin( &L, &arena, &fanin, 1 );
+	const size_t length = L.nown + L.nghost;
+	const int accel = config->accel != ACCEL_NONE;
+	struct history H;
+	memset( &H, 0, sizeof(H) );
+	for( unsigned int t = 0; accel && t < ACCEL_ITERATES; ++t )
+		H.x[ t ] = arena_alloc( &arena, length * sizeof(double) );
+	unsigned int extrapolations = 0;
+	const int adaptive = config->adaptive_threshold > 0.0;
+	struct active act;
+	if( adaptive )
+		active_init( &act, &arena, &L );
+	size_t rows_computed = 0;
+	struct checkpoint_writer cw;
+	if( config->checkpoint != NULL )
+		checkpoint_init( &cw, &arena, config->checkpoint, s, bsp_nprocs(), graph->A.n, L.lo, L.hi );
+	memcpy( x, rank + L.lo, L.nown * sizeof(double) );
+	struct trace *T = traces + s;
+	trace_init( T, bsp_nprocs(), config->report != NULL );
+
+	//send the ghosts of the start vector and sum its dangling rank
+	struct reduction mine, total;
+	local_reduction( &L, x, 0.0, 0.0, &mine );
+	trace_compute( T );
+	plan_send( &fanout, x );
+	share( reduce_buffer, &mine );
+	trace_plan( T, &fanout );
+	trace_all( T, sizeof(struct reduction) );
+	trace_comm( T );
+	bsp_sync();
+	trace_sync( T, config->first_iteration );
+	plan_receive( &fanout, x, 0 );
+	reduce( reduce_buffer, &total );
+	trace_comm( T );
+	//the power method keeps the total rank of the start vector
+	const double mass = total.mass;
+
+	unsigned int w = config->first_iteration;
+	if( accel )
+		history_store( &H, w, x, length, &total );
+	total.residual = total.computed = config->tolerance + 1.0;
+	while( w < config->max_iterations && !(total.residual <= config->tolerance) ) { // Power method
+		double alpha = 0.0, frozen = 0.0;
+		if( config->solver == SOLVER_GAUSS_SEIDEL ) {
+			//a sweep does not keep the total rank, which would otherwise
+			//drift towards the fixed point only as slowly as the damping
+			//lets it; restoring it first leaves the subdominant errors
+			const double scale = mass / total.mass;
+			for( size_t i = 0; i < length; ++i )
+				x[ i ] *= scale;
+			total.dangling *= scale;
+		}
+		//the damped-away rank and the rank that left the matrix
+		//are teleported
+		const double teleport = fudge_factor*total.dangling + 1.0 - fudge_factor;
+		//frozen rows count in the residual with the bound on their change;
+		//once that alone keeps it above the tolerance, they are recomputed
+		if( adaptive )
+			frozen = active_update( &act, &L, x, teleport, total.computed <= config->tolerance );
+		rows_computed += adaptive ? act.nrows : L.nrows;
+		if( config->solver == SOLVER_GAUSS_SEIDEL ) {
+			alpha = sweep( &L, adaptive ? &act : NULL, x, teleport );
+		} else if( adaptive ) {
+			multiply_active( &L, &act, x, y );
+			size_t cursor = 0;
+			for( size_t a = 0; a < act.nrows; ++a ) {
+				const uint32_t r = act.row[ a ];
+				y[ r ] += row_teleport( &L, &cursor, r, teleport );
+				alpha = accumulate( alpha, y[ r ], x[ r ] );
+				active_settle( &act, r, y[ r ], x[ r ] );
+				x[ r ] = y[ r ];
+			}
+		} else {
+			multiply( &L, x, partial, 1 );
+			if( fan_in ) {
+				trace_compute( T );
+				plan_send( &fanin, partial );
+				trace_plan( T, &fanin );
+				trace_comm( T );
+				bsp_sync();
+				trace_sync( T, w + 1 );
+				own_partials( &L, partial, y, 1 );
+				plan_receive( &fanin, y, 1 );
+				trace_comm( T );
+			}
+			add_teleport( &L, y, teleport ); // this is now the vector-matrix product of pi(stationary vector and P (stochastic matrix) + E
+			//local part of the difference with the previous vector
+			for( size_t i = 0; i < L.nown; ++i )
+				alpha = accumulate( alpha, y[ i ], x[ i ] );
+			memcpy( x, y, L.nown * sizeof(double) );
+		}
+		local_reduction( &L, x, alpha, frozen, &mine );
+		const int try_accel = accel && (w + 1) % ACCEL_PERIOD == 0 && H.count >= ACCEL_ITERATES - 1;
+		if( try_accel )
+			history_gram( &H, w + 1, x, L.nown, mine.gram );
+		trace_compute( T );
+		plan_send( &fanout, x );
+		share( reduce_buffer, &mine );
+		trace_plan( T, &fanout );
+		trace_all( T, sizeof(struct reduction) );
+		trace_comm( T );
+		//every processor finishes its last checkpoint before this sync, so
+		//none starts the next one before all are complete; the wait counts
+		//as sync time
+		if( config->checkpoint != NULL && (w + 1) % config->checkpoint_interval == 0 )
+			checkpoint_wait( &cw );
+		bsp_sync();
+		trace_sync( T, w + 1 );
+		plan_receive( &fanout, x, 0 );
+		reduce( reduce_buffer, &total );
+		trace_comm( T );
+		++w;
+		double beta[ 3 ];
+		if( try_accel && !(total.residual <= config->tolerance) && extrapolation_weights( total.gram, beta ) ) {
+			extrapolate( &H, w, beta, x, length, &total );
+			++extrapolations;
+			//earlier iterates do not belong to the new sequence
+			H.count = 0;
+		}
+		if( accel )
+			history_store( &H, w, x, length, &total );
+		if( config->checkpoint != NULL && w % config->checkpoint_interval == 0 )
+			checkpoint_write( &cw, x, w, total.residual );
+	}
+	if( config->checkpoint != NULL )
+		checkpoint_finish( &cw );
+	trace_compute( T );
+
+	memcpy( rank + L.lo, x, L.nown * sizeof(double) );
+	proc_stats[ s ].iterations = w;
+	proc_stats[ s ].extrapolations = extrapolations;
+	proc_stats[ s ].rows_computed = rows_computed;
+	proc_stats[ s ].residual = total.residual;
+	proc_stats[ s ].ghosts = fanout.nrecv;
+	proc_stats[ s ].partials = fan_in ? fanin.send_start[ fanin.nmsgs ] : 0;
+	proc_stats[ s ].messages = fanout.nmsgs + fanin.nmsgs;
+	proc_stats[ s ].stolen = queues != NULL ? queues[ s ].stolen : 0;
+	proc_work[ s ] = L.row_start[ L.nrows ] - L.base + PARTITION_ROW_COST * L.nown;
+	arena_release( &arena );
+	bsp_end();
+}
+
+//sends this processor's per-vector residuals and dangling rank, 2 * width
+//values, to every processor
+static void share_batch( double *reduce_buffer, const double *mine, unsigned int width ) {
+	for( unsigned int k = 0; k < bsp_nprocs(); ++k ) {
+		bsp_put( k, mine, reduce_buffer, 2*width*bsp_pid()*sizeof(double), 2*width*sizeof(double) );
+	}
+}
+
+//combines them as reduce() does, vector by vector
+static void reduce_batch( const double *reduce_buffer, double *total, unsigned int width ) {
+	memcpy( total, reduce_buffer, 2 * width * sizeof(double) );
+	for( unsigned int k = 1; k < bsp_nprocs(); ++k ) {
+		const double *theirs = reduce_buffer + 2 * width * k;
+		for( unsigned int j = 0; j < width; ++j ) {
+			if( config->norm == NORM_L1 )
+				total[ j ] += theirs[ j ];
+			else if( theirs[ j ] > total[ j ] )
+				total[ j ] = theirs[ j ];
+			total[ width + j ] += theirs[ width + j ];
+		}
+	}
+}
+
+static void local_dangling_batch( const struct local *L, const double *x, unsigned int width, double *dangling ) {
+	memset( dangling, 0, width * sizeof(double) );
+	for( size_t k = 0; k < L->ndangling; ++k ) {
+		const double deficit = L->deficit != NULL ? L->deficit[ k ] : 1.0;
+		for( unsigned int j = 0; j < width; ++j )
+			dangling[ j ] += deficit * x[ (L->dangling[ k ] - L->lo) * width + j ];
+	}
+}
+
+//the batched power method: batch_width personalized vectors iterate together,
+//interleaved so that every nonzero loaded is applied to all of them. It uses
+//the distribution, the communication plans (with batch_width values per
+//entry) and the supersteps of spmd(), with plain power-method steps only. The
+//run stops once every vector has converged.
+static void spmd_batch() {
+	bsp_begin( config->nprocs );
+	const unsigned int s = bsp_pid();
+	const unsigned int width = batch_width;
+	//whether partial row sums go to their owners in an extra superstep
+	const int fan_in = config->distribution == DIST_2D || heavy != NULL;
+	struct arena arena;
+	arena_init( &arena );
+	struct local L;
+	if( local_setup( &L, &arena, s ) != 0 )
+		bsp_abort( "Processor %u: out of memory\n", s );
+	double *x = arena_alloc( &arena, (L.nown + L.nghost) * width * sizeof(double) );
+	double *y = arena_alloc( &arena, L.nown * width * sizeof(double) );
+	double *partial = fan_in ? arena_alloc( &arena, L.nrows * width * sizeof(double) ) : y;
+	double *reduce_buffer = arena_alloc_registered( &arena, 2 * width * bsp_nprocs() * sizeof(double) );
+	//per vector: the residual, then the dangling rank
+	double *mine = arena_alloc( &arena, 2 * width * sizeof(double) );
+	double *total = arena_alloc( &arena, 2 * width * sizeof(double) );
+	struct comm_plan fanout, fanin;
+	memset( &fanin, 0, sizeof(fanin) );
+	plan_fanout( &L, &arena, &fanout, width );
+	if( queues != NULL )
+		steal_init( queues + s, &arena, L.nrows, L.row_start, L.base, L.col, L.val, config->chunks );
+	if( placements != NULL )
+		probe_bandwidth( &L, s );
+	if( fan_in )
+		plan_fanin( &L, &arena, &fanin, width );
+	//the owned seeds of every vector
+	size_t *first_seed = arena_alloc( &arena, width * sizeof(size_t) );
+	size_t *nseeds = arena_alloc( &arena, width * sizeof(size_t) );
+	for( unsigned int j = 0; j < width; ++j ) {
+		first_seed[ j ] = lower_bound( batch_vectors[ j ].node, batch_vectors[ j ].count, L.lo );
+		nseeds[ j ] = lower_bound( batch_vectors[ j ].node, batch_vectors[ j ].count, L.hi ) - first_seed[ j ];
+	}
+	memcpy( x, rank + L.lo * width, L.nown * width * sizeof(double) );
+	struct trace *T = traces + s;
+	trace_init( T, bsp_nprocs(), config->report != NULL );
+
+	//send the ghosts of the start vectors and sum their dangling rank
+	memset( mine, 0, width * sizeof(double) );
+	local_dangling_batch( &L, x, width, mine + width );
+	trace_compute( T );
+	plan_send( &fanout, x );
+	share_batch( reduce_buffer, mine, width );
+	trace_plan( T, &fanout );
+	trace_all( T, 2 * width * sizeof(double) );
+	trace_comm( T );
+	bsp_sync();
+	trace_sync( T, 0 );
+	plan_receive( &fanout, x, 0 );
+	reduce_batch( reduce_buffer, total, width );
+	trace_comm( T );
+
+	unsigned int w = 0;
+	double diff = config->tolerance + 1.0;
+	while( w < config->max_iterations && !(diff <= config->tolerance) ) {
+		multiply( &L, x, partial, width );
+		if( fan_in ) {
+			trace_compute( T );
+			plan_send( &fanin, partial );
+			trace_plan( T, &fanin );
+			trace_comm( T );
+			bsp_sync();
+			trace_sync( T, w + 1 );
+			own_partials( &L, partial, y, width );
+			plan_receive( &fanin, y, 1 );
+			trace_comm( T );
+		}
+		for( unsigned int j = 0; j < width; ++j ) {
+			const struct personalization *v = batch_vectors + j;
+			const double teleport = fudge_factor*total[ width + j ] + 1.0 - fudge_factor;
+			for( size_t k = first_seed[ j ]; k < first_seed[ j ] + nseeds[ j ]; ++k )
+				y[ (v->node[ k ] - L.lo) * width + j ] += teleport * v->weight[ k ];
+		}
+		memset( mine, 0, width * sizeof(double) );
+		for( size_t i = 0; i < L.nown; ++i )
+			for( unsigned int j = 0; j < width; ++j )
+				mine[ j ] = accumulate( mine[ j ], y[ i * width + j ], x[ i * width + j ] );
+		memcpy( x, y, L.nown * width * sizeof(double) );
+		local_dangling_batch( &L, x, width, mine + width );
+		trace_compute( T );
+		plan_send( &fanout, x );
+		share_batch( reduce_buffer, mine, width );
+		trace_plan( T, &fanout );
+		trace_all( T, 2 * width * sizeof(double) );
+		trace_comm( T );
+		bsp_sync();
+		trace_sync( T, w + 1 );
+		plan_receive( &fanout, x, 0 );
+		reduce_batch( reduce_buffer, total, width );
+		trace_comm( T );
+		diff = 0.0;
+		for( unsigned int j = 0; j < width; ++j )
+			if( total[ j ] > diff )
+				diff = total[ j ];
+		++w;
+	}
+	trace_compute( T );
+
+	memcpy( rank + L.lo * width, x, L.nown * width * sizeof(double) );
+	proc_stats[ s ].iterations = w;
+	proc_stats[ s ].rows_computed = w * L.nrows;
+	proc_stats[ s ].residual = diff;
+	proc_stats[ s ].ghosts = fanout.nrecv;
+	proc_stats[ s ].partials = fan_in ? fanin.send_start[ fanin.nmsgs ] : 0;
+	proc_stats[ s ].messages = fanout.nmsgs + fanin.nmsgs;
+	proc_stats[ s ].stolen = queues != NULL ? queues[ s ].stolen : 0;
+	proc_work[ s ] = L.row_start[ L.nrows ] - L.base + PARTITION_ROW_COST * L.nown;
+	arena_release( &arena );
+	bsp_end();
+}
+
+//flags the rows of g with more than split times the average nonzeros per
+//processor; returns -1 if out of memory
+static int find_heavy_rows( const struct graph *g, unsigned int P, double split ) {
+	const struct csr *A = &g->A;
+	const double limit = split * A->nnz / P;
+	heavy = calloc( A->n ? A->n : 1, 1 );
+	if( heavy == NULL )
+		return -1;
+	nheavy = 0;
+	for( size_t i = 0; i < A->n; ++i ) {
+		heavy[ i ] = A->row_start[ i + 1 ] - A->row_start[ i ] > limit;
+		nheavy += heavy[ i ];
+	}
+	heavy_rows = malloc( (nheavy ? nheavy : 1) * sizeof(uint32_t) );
+	if( heavy_rows == NULL )
+		return -1;
+	for( size_t i = 0, h = 0; i < A->n; ++i )
+		if( heavy[ i ] )
+			heavy_rows[ h++ ] = i;
+	if( nheavy == 0 ) {
+		free( heavy );
+		free( heavy_rows );
+		heavy = NULL;
+		heavy_rows = NULL;
+	}
+	return 0;
+}
+
+//the default distribution: blocks of about equal work, a node weighing the
+//nonzeros of its row plus PARTITION_ROW_COST. The nonzeros of a split row
+//are counted with the owners of their columns instead.
+static int balance_starts( const struct csr *A, unsigned int P ) {
+	uint64_t *weight = malloc( (A->n ? A->n : 1) * sizeof(uint64_t) );
+	if( weight == NULL )
+		return -1;
+	for( size_t i = 0; i < A->n; ++i )
+		weight[ i ] = PARTITION_ROW_COST + (heavy != NULL && heavy[ i ] ? 0 : A->row_start[ i + 1 ] - A->row_start[ i ]);
+	for( size_t h = 0; h < nheavy; ++h )
+		for( uint64_t k = A->row_start[ heavy_rows[ h ] ]; k < A->row_start[ heavy_rows[ h ] + 1 ]; ++k )
+			++weight[ A->col[ k ] ];
+	partition_split( A->n, weight, P, starts );
+	free( weight );
+	return 0;
+}
+
+//NUMA mode: pins the processors node by node through the MulticoreBSP
+//affinity interface, if there are enough cores; returns the nodes used, or
+//0 with numa_short_node set
+static unsigned int pin_processors( unsigned int P ) {
+	const size_t length = mcbsp_get_maximum_threads();
+	size_t *cpu = malloc( (length > P ? length : P) * sizeof(size_t) );
+	int *node = malloc( P * sizeof(int) );
+	if( cpu == NULL || node == NULL ) {
+		fprintf( stderr, "Out of memory\n" );
+		exit( EXIT_FAILURE );
+	}
+	const unsigned int nodes = numa_pinning( P, cpu, node, &numa_short_node );
+	for( unsigned int s = 0; s < P; ++s )
+		placements[ s ].node = nodes > 0 ? node[ s ] : -1;
+	if( nodes > 0 ) {
+		//the pinning covers every thread MulticoreBSP may start
+		for( size_t k = P; k < length; ++k )
+			cpu[ k ] = cpu[ k % P ];
+		mcbsp_set_pinning( cpu, length );
+	}
+	free( cpu );
+	free( node );
+	return nodes;
+}
+
+//sets up the distribution, runs one SPMD section and collects the statistics
+static void run( void (*section)( void ), const struct graph *g, const struct engine_config *cfg, double *r, struct engine_stats *stats ) {
+	graph = g;
+	config = cfg;
+	rank = r;
+	spmv = kernel_select( cfg->kernel );
+	spmm = kernel_select_spmm( cfg->kernel );
+	fudge_factor = cfg->damping;
+	const unsigned int P = cfg->nprocs;
+	if( P > mcbsp_get_maximum_threads() )
+		mcbsp_set_maximum_threads( P );
+	starts = malloc( (P + 1) * sizeof(size_t) );
+	proc_stats = calloc( P, sizeof(struct engine_stats) );
+	proc_work = calloc( P, sizeof(size_t) );
+	traces = calloc( P, sizeof(struct trace) );
+	queues = cfg->chunks > 1 ? calloc( P, sizeof(struct steal_queue) ) : NULL;
+	placements = cfg->numa ? calloc( P, sizeof(struct placement) ) : NULL;
+	heavy = NULL;
+	heavy_rows = NULL;
+	nheavy = 0;
+	if( starts == NULL || proc_stats == NULL || proc_work == NULL || traces == NULL || (cfg->chunks > 1 && queues == NULL) || (cfg->numa && placements == NULL)
+		|| (cfg->split_rows > 0.0 && cfg->distribution == DIST_1D && find_heavy_rows( g, P, cfg->split_rows ) != 0)
+		|| (cfg->starts == NULL && balance_starts( &g->A, P ) != 0) ) {
+		fprintf( stderr, "Out of memory\n" );
+		exit( EXIT_FAILURE );
+	}
+	if( cfg->starts != NULL )
+		memcpy( starts, cfg->starts, (P + 1) * sizeof(size_t) );
+	//the squarest grid whose shape divides P
+	grid_rows = 1;
+	if( cfg->distribution == DIST_2D )
+		for( unsigned int r = 1; r * r <= P; ++r )
+			if( P % r == 0 )
+				grid_rows = r;
+	grid_cols = P / grid_rows;
+
+	const enum mcbsp_affinity_mode affinity = mcbsp_get_affinity_mode();
+	numa_nodes = placements != NULL ? pin_processors( P ) : 0;
+
+	bsp_init( section, 0, NULL );
+	section();
+	mcbsp_set_affinity_mode( affinity );
+
+	memset( stats, 0, sizeof(*stats) );
+	stats->iterations = proc_stats[ 0 ].iterations;
+	stats->extrapolations = proc_stats[ 0 ].extrapolations;
+	stats->residual = proc_stats[ 0 ].residual;
+	stats->grid_rows = grid_rows;
+	stats->grid_cols = grid_cols;
+	stats->kernel = kernel_resolve( cfg->kernel );
+	size_t total_work = 0, max_work = 0;
+	double total_compute = 0.0, max_compute = 0.0;
+	for( unsigned int s = 0; s < P; ++s ) {
+		total_work += proc_work[ s ];
+		if( proc_work[ s ] > max_work )
+			max_work = proc_work[ s ];
+		total_compute += traces[ s ].compute;
+		if( traces[ s ].compute > max_compute )
+			max_compute = traces[ s ].compute;
+		stats->ghosts += proc_stats[ s ].ghosts;
+		stats->partials += proc_stats[ s ].partials;
+		stats->messages += proc_stats[ s ].messages;
+		stats->stolen += proc_stats[ s ].stolen;
+		stats->rows_computed += proc_stats[ s ].rows_computed;
+		//the slowest processor determines the run time
+		const struct trace *t = traces + s;
+		if( t->compute + t->comm + t->sync > stats->time ) {
+			stats->time = t->compute + t->comm + t->sync;
+			stats->compute = t->compute;
+			stats->comm = t->comm;
+			stats->sync = t->sync;
+		}
+	}
+	for( unsigned int s = 0; placements != NULL && s < P; ++s ) {
+		stats->local_bandwidth += placements[ s ].local_bandwidth / P;
+		stats->remote_bandwidth += placements[ s ].remote_bandwidth / P;
+		traces[ s ].node = placements[ s ].node;
+		traces[ s ].remote_node = placements[ s ].remote_node;
+		traces[ s ].local_bandwidth = placements[ s ].local_bandwidth;
+		traces[ s ].remote_bandwidth = placements[ s ].remote_bandwidth;
+	}
+	stats->numa_nodes = numa_nodes;
+	stats->numa_short_node = numa_short_node;
+	stats->work_imbalance = total_work ? max_work * (double) P / total_work : 1.0;
+	stats->compute_imbalance = total_compute > 0.0 ? max_compute * P / total_compute : 1.0;
+	if( cfg->report != NULL && trace_report( cfg->report, traces, P ) != 0 )
+		exit( EXIT_FAILURE );
+	for( unsigned int s = 0; s < P; ++s )
+		trace_free( traces + s );
+	free( starts );
+	free( heavy );
+	free( heavy_rows );
+	heavy = NULL;
+	heavy_rows = NULL;
+	nheavy = 0;
+	free( proc_stats );
+	free( proc_work );
+	free( queues );
+	queues = NULL;
+	free( placements );
+	placements = NULL;
+	free( traces );
+}
+
+void pagerank_run( const struct graph *g, const struct engine_config *cfg, double *r, struct engine_stats *stats ) {
+	run( &spmd, g, cfg, r, stats );
+}
+
+void pagerank_run_batch( const struct graph *g, const struct engine_config *cfg, unsigned int k, const struct personalization *v, double *r, struct engine_stats *stats ) {
+	batch_width = k;
+	batch_vectors = v;
+	run( &spmd_batch, g, cfg, r, stats );
+}
@@ -0,0 +1,146 @@
+#ifndef _H_ENGINE
+#define _H_ENGINE
+
+#include "kernel.h"
+#include "loader.h"
+
+//the damping factor of PageRank and of the benchmark unless set otherwise
+#define ENGINE_DAMPING 0.9
+
+//how the difference between successive vectors is measured
+enum norm {
+	NORM_L1 = 0,
+	NORM_LINF
+};
+
+//how the matrix nonzeros are assigned to processors
+enum distribution {
+	//every processor holds whole rows and the matching vector entries,
+	//except for the rows split by split_rows
+	DIST_1D = 0,
+	//checkerboard over a processor grid: vector entries are sent along grid
+	//columns (fan-out) and partial row sums along grid rows (fan-in)
+	DIST_2D
+};
+
+//how the owned entries of the next vector are computed
+enum solver {
+	//power method: the whole next vector from the previous one
+	SOLVER_JACOBI = 0,
+	//in place within each processor's rows, so a row uses the entries
+	//updated before it in the same sweep; remote entries are exchanged once
+	//per superstep. Needs the 1D distribution.
+	SOLVER_GAUSS_SEIDEL
+};
+
+//optional acceleration, applied every few iterations to the last iterates
+enum accel {
+	ACCEL_NONE = 0,
+	//vector Aitken delta-squared on the last three iterates
+	ACCEL_AITKEN,
+	//quadratic extrapolation on the last four iterates
+	ACCEL_QUADRATIC
+};
+
+struct engine_config {
+	//damping factor: the share of rank that follows links each step
+	double damping;
+	//where the remaining rank, and the rank that leaves the matrix,
+	//goes; NULL spreads it uniformly over all nodes
+	const struct personalization *personalization;
+	//number of BSP processors; more than the machine has oversubscribes it
+	unsigned int nprocs;
+	//processor s owns the rows and vector entries [starts[s], starts[s+1]);
+	//NULL cuts them into blocks of about equal nonzeros. Any other assignment
+	//is applied by renumbering the nodes first (see partition.h).
+	const size_t *starts;
+	//1D power method only: a row with more than split_rows times the average
+	//nonzeros per processor is split, each processor computing the part of
+	//it whose columns it owns and sending that partial sum to the row owner,
+	//as in the 2D fan-in; 0 keeps all rows whole
+	double split_rows;
+	//stop once the difference between two iterates is at most the tolerance
+	double tolerance;
+	unsigned int max_iterations;
+	enum norm norm;
+	enum distribution distribution;
+	enum solver solver;
+	enum accel accel;
+	//adaptive mode if positive (1D only): a node whose entry changes by at
+	//most this fraction of the tolerance per node (of the tolerance itself
+	//for NORM_INF) for a few iterations in a row is frozen and its row is no
+	//longer computed, until the entries it reads have moved as much or the
+	//computed rows alone have converged
+	double adaptive_threshold;
+	//if above 1, every processor cuts its rows into this many chunks, which
+	//processors done with their own may steal (see steal.h); this applies
+	//to power-method steps, in the adaptive mode to the rows still computed,
+	//but not to Gauss-Seidel sweeps
+	unsigned int chunks;
+	//NUMA mode: the processors are pinned node by node (see numa.h), each
+	//copies its part of the matrix into memory it touches first, and each
+	//measures how fast it reads its own part and a remote one
+	int numa;
+	//sparse matrix-vector kernel, KERNEL_AUTO for the best the CPU supports
+	enum kernel_isa kernel;
+	//if not NULL, every checkpoint_interval iterations each processor
+	//writes its slice of the vector to checkpoint.<pid> (see checkpoint.h)
+	const char *checkpoint;
+	unsigned int checkpoint_interval;
+	//iterations already done, when resuming from a checkpoint; they count
+	//towards max_iterations
+	unsigned int first_iteration;
+	//if not NULL, the per-superstep timing and traffic of every processor is
+	//written there (see trace.h)
+	const char *report;
+};
+
+struct engine_stats {
+	unsigned int iterations;
+	//how many of the iterations were followed by an extrapolation
+	unsigned int extrapolations;
+	double residual;
+	//per iteration, summed over all processors: remote vector entries
+	//fetched, partial row sums sent to row owners (2D or split rows), and
+	//the communication requests used for both
+	size_t ghosts;
+	size_t partials;
+	size_t messages;
+	//chunks of the product computed by a processor other than their owner,
+	//over the whole run
+	size_t stolen;
+	//rows computed over the whole run, summed over all processors; without
+	//the adaptive mode this is the number of rows times the iterations
+	size_t rows_computed;
+	//shape of the processor grid, 1 x P for the 1D distribution
+	unsigned int grid_rows, grid_cols;
+	//the most work (local nonzeros plus PARTITION_ROW_COST per owned entry)
+	//and computation time of a processor, relative to the mean
+	double work_imbalance, compute_imbalance;
+	//NUMA mode: the nodes the processors were pinned over, 0 if node
+	//numa_short_node had too few cores for its processors, and the mean read bandwidth of a processor
+	//over its own matrix part and over one on another node, in bytes per
+	//second; the report has them per processor
+	unsigned int numa_nodes;
+	int numa_short_node;
+	double local_bandwidth, remote_bandwidth;
+	//the kernel that was actually used
+	enum kernel_isa kernel;
+	//wall time of the iteration on the slowest processor, and how it splits
+	//into computation, communication and waiting in syncs
+	double time;
+	double compute, comm, sync;
+};
+
+//runs the power method on g with one persistent SPMD section. On entry rank
+//holds the start vector, on exit the computed stationary vector. Checkpoints
+//are only written by this function, not by the batched one.
+void pagerank_run( const struct graph *g, const struct engine_config *config, double *rank, struct engine_stats *stats );
+
+//the same for k personalized PageRank vectors at once, iterated as one block
+//with every nonzero applied to all of them; config->personalization is
+//ignored and only plain power-method steps are taken. rank holds the k
+//vectors interleaved: entry i of vector j is rank[i * k + j].
+void pagerank_run_batch( const struct graph *g, const struct engine_config *config, unsigned int k, const struct personalization *v, double *rank, struct engine_stats *stats );
+
+#endif
@@ -0,0 +1,224 @@
+#include "kernel.h"
+
+#include <immintrin.h>
+#include <string.h>
+
+static const char *names[] = { "auto", "scalar", "sse2", "avx2", "avx512" };
+
+static void spmv_scalar( size_t nrows, const uint64_t *row_start, const uint32_t *col, const double *val, const double *x, double scale, double *y ) {
+	const uint64_t base = row_start[ 0 ];
+	for( size_t r = 0; r < nrows; ++r ) {
+		double alpha = 0.0;
+		for( uint64_t k = row_start[ r ] - base; k < row_start[ r + 1 ] - base; ++k )
+			alpha += val[ k ] * x[ col[ k ] ];
+		y[ r ] = scale * alpha;
+	}
+}
+
+//SSE2 has no gather; two x entries are loaded separately per step
+__attribute__((target("sse2")))
+static void spmv_sse2( size_t nrows, const uint64_t *row_start, const uint32_t *col, const double *val, const double *x, double scale, double *y ) {
+	const uint64_t base = row_start[ 0 ];
+	for( size_t r = 0; r < nrows; ++r ) {
+		uint64_t k = row_start[ r ] - base;
+		const uint64_t end = row_start[ r + 1 ] - base;
+		__m128d acc = _mm_setzero_pd();
+		for( ; k + 2 <= end; k += 2 ) {
+			const __m128d xs = _mm_set_pd( x[ col[ k + 1 ] ], x[ col[ k ] ] );
+			acc = _mm_add_pd( acc, _mm_mul_pd( _mm_loadu_pd( val + k ), xs ) );
+		}
+		double alpha = _mm_cvtsd_f64( _mm_add_sd( acc, _mm_unpackhi_pd( acc, acc ) ) );
+		for( ; k < end; ++k )
+			alpha += val[ k ] * x[ col[ k ] ];
+		y[ r ] = scale * alpha;
+	}
+}
+
+__attribute__((target("avx2,fma")))
+static void spmv_avx2( size_t nrows, const uint64_t *row_start, const uint32_t *col, const double *val, const double *x, double scale, double *y ) {
+	const uint64_t base = row_start[ 0 ];
+	for( size_t r = 0; r < nrows; ++r ) {
+		uint64_t k = row_start[ r ] - base;
+		const uint64_t end = row_start[ r + 1 ] - base;
+		__m256d acc = _mm256_setzero_pd();
+		for( ; k + 4 <= end; k += 4 ) {
+			const __m128i idx = _mm_loadu_si128( (const __m128i *) (col + k) );
+			const __m256d xs = _mm256_i32gather_pd( x, idx, sizeof(double) );
+			acc = _mm256_fmadd_pd( _mm256_loadu_pd( val + k ), xs, acc );
+		}
+		const __m128d half = _mm_add_pd( _mm256_castpd256_pd128( acc ), _mm256_extractf128_pd( acc, 1 ) );
+		double alpha = _mm_cvtsd_f64( _mm_add_sd( half, _mm_unpackhi_pd( half, half ) ) );
+		for( ; k < end; ++k )
+			alpha += val[ k ] * x[ col[ k ] ];
+		y[ r ] = scale * alpha;
+	}
+}
+
+__attribute__((target("avx512f")))
+static void spmv_avx512( size_t nrows, const uint64_t *row_start, const uint32_t *col, const double *val, const double *x, double scale, double *y ) {
+	const uint64_t base = row_start[ 0 ];
+	for( size_t r = 0; r < nrows; ++r ) {
+		uint64_t k = row_start[ r ] - base;
+		const uint64_t end = row_start[ r + 1 ] - base;
+		__m512d acc = _mm512_setzero_pd();
+		for( ; k + 8 <= end; k += 8 ) {
+			const __m256i idx = _mm256_loadu_si256( (const __m256i *) (col + k) );
+			const __m512d xs = _mm512_i32gather_pd( idx, x, sizeof(double) );
+			acc = _mm512_fmadd_pd( _mm512_loadu_pd( val + k ), xs, acc );
+		}
+		//the remainder of the row as one masked step
+		if( k < end ) {
+			const __mmask8 mask = (__mmask8) ((1u << (end - k)) - 1);
+			const __m256i idx = _mm512_castsi512_si256( _mm512_maskz_loadu_epi32( mask, col + k ) );
+			const __m512d xs = _mm512_mask_i32gather_pd( _mm512_setzero_pd(), mask, idx, x, sizeof(double) );
+			acc = _mm512_fmadd_pd( _mm512_maskz_loadu_pd( mask, val + k ), xs, acc );
+		}
+		y[ r ] = scale * _mm512_reduce_add_pd( acc );
+	}
+}
+
+//the same product for width interleaved vectors (SpMM): every nonzero is
+//applied to all of them, the vectors of one row are contiguous and so need no
+//gathers. The widest blocks of vectors are done in registers, any remaining
+//vectors one at a time.
+static void spmm_rest( uint64_t first, uint64_t end, const uint32_t *col, const double *val, const double *x, unsigned int width, unsigned int j, double scale, double *y ) {
+	for( ; j < width; ++j ) {
+		double alpha = 0.0;
+		for( uint64_t k = first; k < end; ++k )
+			alpha += val[ k ] * x[ (size_t) col[ k ] * width + j ];
+		y[ j ] = scale * alpha;
+	}
+}
+
+static void spmm_scalar( size_t nrows, const uint64_t *row_start, const uint32_t *col, const double *val, const double *x, unsigned int width, double scale, double *y ) {
+	const uint64_t base = row_start[ 0 ];
+	for( size_t r = 0; r < nrows; ++r )
+		spmm_rest( row_start[ r ] - base, row_start[ r + 1 ] - base, col, val, x, width, 0, scale, y + r * width );
+}
+
+__attribute__((target("sse2")))
+static void spmm_sse2( size_t nrows, const uint64_t *row_start, const uint32_t *col, const double *val, const double *x, unsigned int width, double scale, double *y ) {
+	const uint64_t base = row_start[ 0 ];
+	for( size_t r = 0; r < nrows; ++r ) {
+		const uint64_t first = row_start[ r ] - base, end = row_start[ r + 1 ] - base;
+		double *out = y + r * width;
+		unsigned int j = 0;
+		for( ; j + 2 <= width; j += 2 ) {
+			__m128d acc = _mm_setzero_pd();
+			for( uint64_t k = first; k < end; ++k )
+				acc = _mm_add_pd( acc, _mm_mul_pd( _mm_set1_pd( val[ k ] ), _mm_loadu_pd( x + (size_t) col[ k ] * width + j ) ) );
+			_mm_storeu_pd( out + j, _mm_mul_pd( acc, _mm_set1_pd( scale ) ) );
+		}
+		spmm_rest( first, end, col, val, x, width, j, scale, out );
+	}
+}
+
+__attribute__((target("avx2,fma")))
+static void spmm_avx2( size_t nrows, const uint64_t *row_start, const uint32_t *col, const double *val, const double *x, unsigned int width, double scale, double *y ) {
+	const uint64_t base = row_start[ 0 ];
+	for( size_t r = 0; r < nrows; ++r ) {
+		const uint64_t first = row_start[ r ] - base, end = row_start[ r + 1 ] - base;
+		double *out = y + r * width;
+		unsigned int j = 0;
+		//two registers per step hide the FMA latency
+		for( ; j + 8 <= width; j += 8 ) {
+			__m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+			for( uint64_t k = first; k < end; ++k ) {
+				const __m256d v = _mm256_set1_pd( val[ k ] );
+				const double *in = x + (size_t) col[ k ] * width + j;
+				acc0 = _mm256_fmadd_pd( v, _mm256_loadu_pd( in ), acc0 );
+				acc1 = _mm256_fmadd_pd( v, _mm256_loadu_pd( in + 4 ), acc1 );
+			}
+			_mm256_storeu_pd( out + j, _mm256_mul_pd( acc0, _mm256_set1_pd( scale ) ) );
+			_mm256_storeu_pd( out + j + 4, _mm256_mul_pd( acc1, _mm256_set1_pd( scale ) ) );
+		}
+		for( ; j + 4 <= width; j += 4 ) {
+			__m256d acc = _mm256_setzero_pd();
+			for( uint64_t k = first; k < end; ++k )
+				acc = _mm256_fmadd_pd( _mm256_set1_pd( val[ k ] ), _mm256_loadu_pd( x + (size_t) col[ k ] * width + j ), acc );
+			_mm256_storeu_pd( out + j, _mm256_mul_pd( acc, _mm256_set1_pd( scale ) ) );
+		}
+		spmm_rest( first, end, col, val, x, width, j, scale, out );
+	}
+}
+
+__attribute__((target("avx512f")))
+static void spmm_avx512( size_t nrows, const uint64_t *row_start, const uint32_t *col, const double *val, const double *x, unsigned int width, double scale, double *y ) {
+	const uint64_t base = row_start[ 0 ];
+	for( size_t r = 0; r < nrows; ++r ) {
+		const uint64_t first = row_start[ r ] - base, end = row_start[ r + 1 ] - base;
+		double *out = y + r * width;
+		for( unsigned int j = 0; j < width; j += 8 ) {
+			//the last block of fewer than eight vectors is masked
+			const __mmask8 mask = width - j >= 8 ? 0xff : (__mmask8) ((1u << (width - j)) - 1);
+			__m512d acc = _mm512_setzero_pd();
+			for( uint64_t k = first; k < end; ++k )
+				acc = _mm512_fmadd_pd( _mm512_set1_pd( val[ k ] ), _mm512_maskz_loadu_pd( mask, x + (size_t) col[ k ] * width + j ), acc );
+			_mm512_mask_storeu_pd( out + j, mask, _mm512_mul_pd( acc, _mm512_set1_pd( scale ) ) );
+		}
+	}
+}
+
+int kernel_parse( const char *name, enum kernel_isa *isa ) {
+	for( unsigned int k = 0; k < sizeof(names) / sizeof(names[ 0 ]); ++k ) {
+		if( strcmp( name, names[ k ] ) == 0 ) {
+			*isa = (enum kernel_isa) k;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static int supported( enum kernel_isa isa ) {
+	__builtin_cpu_init();
+	switch( isa ) {
+	case KERNEL_SCALAR:
+		return 1;
+	case KERNEL_SSE2:
+		return __builtin_cpu_supports( "sse2" );
+	case KERNEL_AVX2:
+		return __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" );
+	case KERNEL_AVX512:
+		return __builtin_cpu_supports( "avx512f" );
+	default:
+		return 0;
+	}
+}
+
+enum kernel_isa kernel_resolve( enum kernel_isa isa ) {
+	if( isa != KERNEL_AUTO && supported( isa ) )
+		return isa;
+	for( isa = KERNEL_AVX512; isa > KERNEL_SCALAR && !supported( isa ); --isa )
+		;
+	return isa;
+}
+
+spmv_kernel kernel_select( enum kernel_isa isa ) {
+	switch( kernel_resolve( isa ) ) {
+	case KERNEL_AVX512:
+		return spmv_avx512;
+	case KERNEL_AVX2:
+		return spmv_avx2;
+	case KERNEL_SSE2:
+		return spmv_sse2;
+	default:
+		return spmv_scalar;
+	}
+}
+
+spmm_kernel kernel_select_spmm( enum kernel_isa isa ) {
+	switch( kernel_resolve( isa ) ) {
+	case KERNEL_AVX512:
+		return spmm_avx512;
+	case KERNEL_AVX2:
+		return spmm_avx2;
+	case KERNEL_SSE2:
+		return spmm_sse2;
+	default:
+		return spmm_scalar;
+	}
+}
+
+const char * kernel_name( enum kernel_isa isa ) {
+	return names[ isa ];
+}
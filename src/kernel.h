@@ -0,0 +1,42 @@
+#ifndef _H_KERNEL
+#define _H_KERNEL
+
+#include <stddef.h>
+#include <stdint.h>
+
+//The sparse matrix-vector product is the innermost loop of the power method.
+//It comes in a scalar version and in SSE2, AVX2 and AVX-512 versions that
+//gather the x entries of several nonzeros at once; kernel_select picks the
+//widest one the CPU supports. The batched product over several vectors has
+//the same set of versions.
+
+enum kernel_isa {
+	KERNEL_AUTO = 0,
+	KERNEL_SCALAR,
+	KERNEL_SSE2,
+	KERNEL_AVX2,
+	KERNEL_AVX512
+};
+
+//y[r] = scale * sum of val[k] * x[col[k]] over the nonzeros k of row r, for
+//the nrows rows starting at row_start[0]; entries are addressed relative to
+//row_start[0]. Local column indices must be below 2^31.
+typedef void (*spmv_kernel)( size_t nrows, const uint64_t *row_start, const uint32_t *col, const double *val, const double *x, double scale, double *y );
+
+//the same for width vectors stored interleaved: entry i of vector j is
+//x[i * width + j], and row r of the result goes to y[r * width + j]
+typedef void (*spmm_kernel)( size_t nrows, const uint64_t *row_start, const uint32_t *col, const double *val, const double *x, unsigned int width, double scale, double *y );
+
+//parses a kernel name as given on the command line, returns -1 if unknown
+int kernel_parse( const char *name, enum kernel_isa *isa );
+
+//resolves KERNEL_AUTO, or a kernel the CPU cannot run, to the best supported one
+enum kernel_isa kernel_resolve( enum kernel_isa isa );
+
+spmv_kernel kernel_select( enum kernel_isa isa );
+
+spmm_kernel kernel_select_spmm( enum kernel_isa isa );
+
+const char * kernel_name( enum kernel_isa isa );
+
+#endif
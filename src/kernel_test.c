@@ -0,0 +1,114 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "kernel.h"
+
+//Checks every SIMD kernel the CPU supports against the scalar one on random
+//CSR matrices. Rows have 0 to MAX_ROW nonzeros, so every remainder and mask
+//path of the gathers runs, and the batched product is tried for every width
+//up to MAX_WIDTH, most of which are not multiples of the vector length.
+
+#define MAX_ROW 17
+#define MAX_WIDTH 19
+//rows of every length
+#define REPEATS 5
+#define COLUMNS 1000
+//allowed error relative to the sum of the magnitudes of a row's products
+#define TOLERANCE 1e-13
+
+static uint64_t state = 42;
+
+static uint64_t next_random( void ) {
+	uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+//uniform in [-1, 1)
+static double next_value( void ) {
+	return (next_random() >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+}
+
+//the largest error of y against the reference, relative to the magnitudes
+//of the products summed into each entry
+static double compare( size_t nrows, const uint64_t *row_start, const uint32_t *col, const double *val, const double *x, unsigned int width, const double *ref, const double *y ) {
+	double worst = 0.0;
+	for( size_t r = 0; r < nrows; ++r ) {
+		for( unsigned int j = 0; j < width; ++j ) {
+			double magnitude = 0.0;
+			for( uint64_t k = row_start[ r ]; k < row_start[ r + 1 ]; ++k )
+				magnitude += fabs( val[ k ] * x[ (size_t) col[ k ] * width + j ] );
+			const double error = fabs( y[ r * width + j ] - ref[ r * width + j ] );
+			if( error > 0.0 && !(error <= TOLERANCE * magnitude) ) {
+				const double relative = magnitude > 0.0 ? error / magnitude : INFINITY;
+				if( !(relative <= worst) )
+					worst = relative;
+			}
+		}
+	}
+	return worst;
+}
+
+int main( void ) {
+	const size_t nrows = (MAX_ROW + 1) * REPEATS;
+	uint64_t *row_start = malloc( (nrows + 1) * sizeof(uint64_t) );
+	if( row_start == NULL )
+		return EXIT_FAILURE;
+	//row lengths 0, 1, ..., MAX_ROW, then again, in shuffled order
+	row_start[ 0 ] = 0;
+	for( size_t r = 0; r < nrows; ++r )
+		row_start[ r + 1 ] = row_start[ r ] + (r * 7) % (MAX_ROW + 1);
+	const size_t nnz = row_start[ nrows ];
+	uint32_t *col = malloc( (nnz ? nnz : 1) * sizeof(uint32_t) );
+	double *val = malloc( (nnz ? nnz : 1) * sizeof(double) );
+	double *x = malloc( COLUMNS * MAX_WIDTH * sizeof(double) );
+	double *ref = malloc( nrows * MAX_WIDTH * sizeof(double) );
+	double *y = malloc( nrows * MAX_WIDTH * sizeof(double) );
+	if( col == NULL || val == NULL || x == NULL || ref == NULL || y == NULL )
+		return EXIT_FAILURE;
+	for( size_t k = 0; k < nnz; ++k ) {
+		col[ k ] = next_random() % COLUMNS;
+		val[ k ] = next_value();
+	}
+	for( size_t i = 0; i < COLUMNS * MAX_WIDTH; ++i )
+		x[ i ] = next_value();
+	const double scale = 0.85;
+
+	int failed = 0;
+	const spmv_kernel spmv_ref = kernel_select( KERNEL_SCALAR );
+	const spmm_kernel spmm_ref = kernel_select_spmm( KERNEL_SCALAR );
+	for( enum kernel_isa isa = KERNEL_SSE2; isa <= KERNEL_AVX512; ++isa ) {
+		if( kernel_resolve( isa ) != isa ) {
+			printf( "%-7s not supported by this CPU, skipped\n", kernel_name( isa ) );
+			continue;
+		}
+		//a kernel may be handed any range of rows, so start past the first
+		double worst = 0.0;
+		for( size_t first = 0; first < 2; ++first ) {
+			spmv_ref( nrows - first, row_start + first, col + row_start[ first ], val + row_start[ first ], x, scale, ref );
+			kernel_select( isa )( nrows - first, row_start + first, col + row_start[ first ], val + row_start[ first ], x, scale, y );
+			const double e = compare( nrows - first, row_start + first, col, val, x, 1, ref, y );
+			worst = e > worst ? e : worst;
+		}
+		for( unsigned int width = 1; width <= MAX_WIDTH; ++width ) {
+			spmm_ref( nrows, row_start, col, val, x, width, scale, ref );
+			kernel_select_spmm( isa )( nrows, row_start, col, val, x, width, scale, y );
+			const double e = compare( nrows, row_start, col, val, x, width, ref, y );
+			worst = e > worst ? e : worst;
+		}
+		printf( "%-7s %s\n", kernel_name( isa ), worst > 0.0 ? "FAILED" : "ok" );
+		if( worst > 0.0 ) {
+			printf( "        largest relative error %g\n", worst );
+			failed = 1;
+		}
+	}
+	free( row_start );
+	free( col );
+	free( val );
+	free( x );
+	free( ref );
+	free( y );
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
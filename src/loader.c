@@ -0,0 +1,970 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "loader.h"
+#include "binfile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+//growable edge list; w stays NULL for unweighted inputs
+struct edges {
+	size_t m, cap;
+	uint32_t *src;
+	uint32_t *dst;
+	double *w;
+};
+
+//cursor over the NUL-terminated contents of a file
+struct tokenizer {
+	const char *p;
+	const char *path;
+	size_t line;
+};
+
+int graph_format_parse( const char *name, enum graph_format *format ) {
+	if( strcmp( name, "auto" ) == 0 )
+		*format = FORMAT_AUTO;
+	else if( strcmp( name, "edges" ) == 0 || strcmp( name, "snap" ) == 0 )
+		*format = FORMAT_EDGES;
+	else if( strcmp( name, "mtx" ) == 0 )
+		*format = FORMAT_MTX;
+	else if( strcmp( name, "dense" ) == 0 )
+		*format = FORMAT_DENSE;
+	else if( strcmp( name, "bin" ) == 0 )
+		*format = FORMAT_BINARY;
+	else
+		return -1;
+	return 0;
+}
+
+//reads a whole file into one NUL-terminated buffer
+static char * slurp( const char *path, size_t *length ) {
+	FILE *file = fopen( path, "rb" );
+	if( file == NULL ) {
+		perror( path );
+		return NULL;
+	}
+	char *buffer = NULL;
+	long size = -1;
+	if( fseek( file, 0, SEEK_END ) == 0 )
+		size = ftell( file );
+	if( size >= 0 && fseek( file, 0, SEEK_SET ) == 0 )
+		buffer = malloc( (size_t) size + 1 );
+	if( buffer != NULL && fread( buffer, 1, (size_t) size, file ) != (size_t) size ) {
+		free( buffer );
+		buffer = NULL;
+	}
+	fclose( file );
+	if( buffer == NULL ) {
+		fprintf( stderr, "%s: could not read file\n", path );
+		return NULL;
+	}
+	buffer[ size ] = '\0';
+	*length = (size_t) size;
+	return buffer;
+}
+
+static void skip_blanks( struct tokenizer *t ) {
+	while( *t->p == ' ' || *t->p == '\t' || *t->p == '\r' )
+		++t->p;
+}
+
+//true if only blanks remain on the current line
+static int at_eol( struct tokenizer *t ) {
+	skip_blanks( t );
+	return *t->p == '\n' || *t->p == '\0';
+}
+
+static void next_line( struct tokenizer *t ) {
+	while( *t->p != '\n' && *t->p != '\0' )
+		++t->p;
+	if( *t->p == '\n' ) {
+		++t->p;
+		++t->line;
+	}
+}
+
+//skips empty lines and lines starting with the comment character
+static void skip_comments( struct tokenizer *t, char comment ) {
+	for( ;; ) {
+		skip_blanks( t );
+		if( *t->p == comment || *t->p == '\n' )
+			next_line( t );
+		else
+			return;
+	}
+}
+
+static int parse_error( struct tokenizer *t, const char *what ) {
+	fprintf( stderr, "%s:%zu: %s\n", t->path, t->line, what );
+	return -1;
+}
+
+static int next_uint( struct tokenizer *t, uint64_t *value ) {
+	skip_blanks( t );
+	if( *t->p < '0' || *t->p > '9' )
+		return parse_error( t, "expected an unsigned integer" );
+	uint64_t v = 0;
+	while( *t->p >= '0' && *t->p <= '9' ) {
+		const uint64_t digit = *t->p - '0';
+		if( v > (UINT64_MAX - digit) / 10 )
+			return parse_error( t, "integer out of range" );
+		v = v * 10 + digit;
+		++t->p;
+	}
+	*value = v;
+	return 0;
+}
+
+static int next_double( struct tokenizer *t, double *value ) {
+	skip_blanks( t );
+	char *end;
+	*value = strtod( t->p, &end );
+	if( end == t->p )
+		return parse_error( t, "expected a number" );
+	t->p = end;
+	return 0;
+}
+
+static int edges_push( struct edges *e, uint64_t src, uint64_t dst, double w ) {
+	if( e->m == e->cap ) {
+		const size_t cap = e->cap ? 2 * e->cap : 1024;
+		uint32_t *s = realloc( e->src, cap * sizeof(uint32_t) );
+		if( s == NULL )
+			return -1;
+		e->src = s;
+		uint32_t *d = realloc( e->dst, cap * sizeof(uint32_t) );
+		if( d == NULL )
+			return -1;
+		e->dst = d;
+		if( e->w != NULL ) {
+			double *ww = realloc( e->w, cap * sizeof(double) );
+			if( ww == NULL )
+				return -1;
+			e->w = ww;
+		}
+		e->cap = cap;
+	}
+	e->src[ e->m ] = src;
+	e->dst[ e->m ] = dst;
+	if( e->w != NULL )
+		e->w[ e->m ] = w;
+	++e->m;
+	return 0;
+}
+
+static void edges_free( struct edges *e ) {
+	free( e->src );
+	free( e->dst );
+	free( e->w );
+}
+
+//builds the column-stochastic transition matrix from an edge list: edge s->d
+//becomes entry (d,s) with value w / (total out-weight of s). The nonzeros are
+//bucketed by source first so that every row ends up with sorted columns, and
+//repeated edges are merged into one nonzero.
+static int build_transition( struct graph *g, size_t n, const struct edges *e ) {
+	uint64_t *out_start = calloc( n + 1, sizeof(uint64_t) );
+	uint64_t *cursor = calloc( n + 1, sizeof(uint64_t) );
+	double *out_weight = calloc( n ? n : 1, sizeof(double) );
+	size_t *by_source = malloc( (e->m ? e->m : 1) * sizeof(size_t) );
+	int rc = -1;
+	if( out_start == NULL || cursor == NULL || out_weight == NULL || by_source == NULL )
+		goto out;
+
+	for( size_t k = 0; k < e->m; ++k ) {
+		++out_start[ e->src[ k ] + 1 ];
+		++cursor[ e->dst[ k ] + 1 ];
+		out_weight[ e->src[ k ] ] += e->w != NULL ? e->w[ k ] : 1.0;
+	}
+	for( size_t i = 0; i < n; ++i ) {
+		out_start[ i + 1 ] += out_start[ i ];
+		cursor[ i + 1 ] += cursor[ i ];
+	}
+	for( size_t k = 0; k < e->m; ++k )
+		by_source[ out_start[ e->src[ k ] ]++ ] = k;
+
+	if( csr_alloc( &g->A, n, e->m ) != 0 )
+		goto out;
+	struct csr *A = &g->A;
+	memcpy( A->row_start, cursor, (n + 1) * sizeof(uint64_t) );
+	for( size_t i = 0; i < e->m; ++i ) {
+		const size_t k = by_source[ i ];
+		const uint32_t s = e->src[ k ];
+		const uint64_t to = cursor[ e->dst[ k ] ]++;
+		A->col[ to ] = s;
+		A->val[ to ] = (e->w != NULL ? e->w[ k ] : 1.0) / out_weight[ s ];
+	}
+
+	//merge duplicate edges, which sit next to each other within a row
+	size_t nnz = 0;
+	for( size_t i = 0; i < n; ++i ) {
+		const uint64_t begin = A->row_start[ i ], end = A->row_start[ i + 1 ];
+		A->row_start[ i ] = nnz;
+		for( uint64_t k = begin; k < end; ++k ) {
+			if( k > begin && A->col[ k ] == A->col[ nnz - 1 ] ) {
+				A->val[ nnz - 1 ] += A->val[ k ];
+			} else {
+				A->col[ nnz ] = A->col[ k ];
+				A->val[ nnz ] = A->val[ k ];
+				++nnz;
+			}
+		}
+	}
+	A->row_start[ n ] = nnz;
+	A->nnz = nnz;
+
+	g->ndangling = 0;
+	for( size_t i = 0; i < n; ++i )
+		if( out_weight[ i ] == 0.0 )
+			++g->ndangling;
+	g->dangling = malloc( (g->ndangling ? g->ndangling : 1) * sizeof(uint32_t) );
+	if( g->dangling == NULL ) {
+		csr_free( A );
+		goto out;
+	}
+	for( size_t i = 0, k = 0; i < n; ++i )
+		if( out_weight[ i ] == 0.0 )
+			g->dangling[ k++ ] = i;
+	rc = 0;
+out:
+	free( out_start );
+	free( cursor );
+	free( out_weight );
+	free( by_source );
+	return rc;
+}
+
+//SNAP edge list: node ids are used as given, n is the largest id plus one
+static int parse_edges( struct tokenizer *t, size_t length, struct edges *e, size_t *n ) {
+	//a typical edge line is a little over 10 bytes, reserve for that up front
+	e->cap = length / 12 + 1024;
+	e->src = malloc( e->cap * sizeof(uint32_t) );
+	e->dst = malloc( e->cap * sizeof(uint32_t) );
+	if( e->src == NULL || e->dst == NULL )
+		return -1;
+	uint64_t max_id = 0;
+	int any = 0;
+	for( ;; ) {
+		skip_comments( t, '#' );
+		if( *t->p == '\0' )
+			break;
+		uint64_t s, d;
+		if( next_uint( t, &s ) != 0 || next_uint( t, &d ) != 0 )
+			return -1;
+		if( s >= UINT32_MAX || d >= UINT32_MAX )
+			return parse_error( t, "node id does not fit in 32 bits" );
+		if( edges_push( e, s, d, 1.0 ) != 0 )
+			return parse_error( t, "out of memory" );
+		if( s > max_id ) max_id = s;
+		if( d > max_id ) max_id = d;
+		any = 1;
+		//SNAP files sometimes carry extra columns such as timestamps
+		next_line( t );
+	}
+	*n = any ? max_id + 1 : 0;
+	return 0;
+}
+
+//MatrixMarket coordinate file with a pattern, integer or real field and a
+//general or symmetric layout; indices are 1-based
+static int parse_mtx( struct tokenizer *t, struct edges *e, size_t *n ) {
+	char object[ 32 ], layout[ 32 ], field[ 32 ], symmetry[ 32 ];
+	if( sscanf( t->p, "%%%%MatrixMarket %31s %31s %31s %31s", object, layout, field, symmetry ) != 4
+		|| strcmp( object, "matrix" ) != 0 || strcmp( layout, "coordinate" ) != 0 )
+		return parse_error( t, "expected a `%%MatrixMarket matrix coordinate' header" );
+	const int weighted = strcmp( field, "pattern" ) != 0;
+	const int symmetric = strcmp( symmetry, "general" ) != 0;
+	if( weighted && strcmp( field, "real" ) != 0 && strcmp( field, "integer" ) != 0 )
+		return parse_error( t, "unsupported MatrixMarket field" );
+	if( symmetric && strcmp( symmetry, "symmetric" ) != 0 )
+		return parse_error( t, "unsupported MatrixMarket symmetry" );
+	next_line( t );
+
+	skip_comments( t, '%' );
+	uint64_t rows, cols, entries;
+	if( next_uint( t, &rows ) != 0 || next_uint( t, &cols ) != 0 || next_uint( t, &entries ) != 0 )
+		return -1;
+	*n = rows > cols ? rows : cols;
+	if( *n >= UINT32_MAX )
+		return parse_error( t, "matrix dimension does not fit in 32 bits" );
+	next_line( t );
+
+	e->cap = (symmetric ? 2 : 1) * entries + 1;
+	e->src = malloc( e->cap * sizeof(uint32_t) );
+	e->dst = malloc( e->cap * sizeof(uint32_t) );
+	if( weighted )
+		e->w = malloc( e->cap * sizeof(double) );
+	if( e->src == NULL || e->dst == NULL || (weighted && e->w == NULL) )
+		return parse_error( t, "out of memory" );
+	for( uint64_t k = 0; k < entries; ++k ) {
+		skip_comments( t, '%' );
+		uint64_t i, j;
+		double v = 1.0;
+		if( next_uint( t, &i ) != 0 || next_uint( t, &j ) != 0 )
+			return -1;
+		if( weighted && next_double( t, &v ) != 0 )
+			return -1;
+		if( i == 0 || j == 0 || i > rows || j > cols )
+			return parse_error( t, "index out of range" );
+		if( !(v >= 0.0) )
+			return parse_error( t, "negative edge weight" );
+		//an explicit zero is a stored zero, not an edge; as the only
+		//out-edge of a node it would leave a zero out-weight to divide by
+		if( v == 0.0 ) {
+			next_line( t );
+			continue;
+		}
+		if( edges_push( e, i - 1, j - 1, v ) != 0 )
+			return parse_error( t, "out of memory" );
+		if( symmetric && i != j && edges_push( e, j - 1, i - 1, v ) != 0 )
+			return parse_error( t, "out of memory" );
+		next_line( t );
+	}
+	return 0;
+}
+
+//lists the nodes of a matrix taken as is whose column does not sum to one,
+//with what their column lacks
+static int find_deficits( struct graph *g ) {
+	const struct csr *A = &g->A;
+	double *sum = calloc( A->n ? A->n : 1, sizeof(double) );
+	if( sum == NULL )
+		return -1;
+	for( size_t k = 0; k < A->nnz; ++k )
+		sum[ A->col[ k ] ] += A->val[ k ];
+	g->ndangling = 0;
+	for( size_t j = 0; j < A->n; ++j )
+		if( sum[ j ] < 1.0 - 1e-12 || sum[ j ] > 1.0 + 1e-12 )
+			++g->ndangling;
+	g->dangling = malloc( (g->ndangling ? g->ndangling : 1) * sizeof(uint32_t) );
+	g->deficit = malloc( (g->ndangling ? g->ndangling : 1) * sizeof(double) );
+	if( g->dangling == NULL || g->deficit == NULL ) {
+		free( sum );
+		return -1;
+	}
+	for( size_t j = 0, k = 0; j < A->n; ++j ) {
+		if( sum[ j ] < 1.0 - 1e-12 || sum[ j ] > 1.0 + 1e-12 ) {
+			g->dangling[ k ] = j;
+			g->deficit[ k++ ] = 1.0 - sum[ j ];
+		}
+	}
+	free( sum );
+	return 0;
+}
+
+//dense matrix: the number of values on the first line fixes n; rows are
+//converted to CSR while parsing so no n*n buffer is ever allocated
+static int parse_dense( struct tokenizer *t, size_t length, struct graph *g ) {
+	skip_comments( t, '#' );
+	struct tokenizer first = *t;
+	size_t n = 0;
+	double v;
+	while( !at_eol( &first ) ) {
+		if( next_double( &first, &v ) != 0 )
+			return -1;
+		++n;
+	}
+	if( n == 0 )
+		return parse_error( t, "empty matrix" );
+	//a nonzero takes at least two bytes of text
+	size_t cap = length / 2 + 1;
+	if( cap > n * n )
+		cap = n * n;
+	if( csr_alloc( &g->A, n, cap ) != 0 )
+		return parse_error( t, "out of memory" );
+	struct csr *A = &g->A;
+	size_t nnz = 0;
+	int rc = 0;
+	for( size_t i = 0; i < n && rc == 0; ++i ) {
+		for( size_t j = 0; j < n; ++j ) {
+			skip_comments( t, '#' );
+			if( *t->p == '\0' ) {
+				rc = parse_error( t, "matrix is not square" );
+				break;
+			}
+			if( (rc = next_double( t, &v )) != 0 )
+				break;
+			if( v != 0.0 ) {
+				A->col[ nnz ] = j;
+				A->val[ nnz ] = v;
+				++nnz;
+			}
+		}
+		A->row_start[ i + 1 ] = nnz;
+	}
+	skip_comments( t, '#' );
+	if( rc == 0 && *t->p != '\0' )
+		rc = parse_error( t, "matrix is not square" );
+	A->nnz = nnz;
+	if( rc == 0 && find_deficits( g ) != 0 )
+		rc = parse_error( t, "out of memory" );
+	if( rc != 0 )
+		graph_free( g );
+	return rc;
+}
+
+//guesses the format: a MatrixMarket banner, else an edge list if the first
+//data line holds two integers, else a dense matrix
+static enum graph_format detect( const char *text ) {
+	if( strncmp( text, "%%MatrixMarket", 14 ) == 0 )
+		return FORMAT_MTX;
+	struct tokenizer t = { text, "", 1 };
+	skip_comments( &t, '#' );
+	size_t tokens = 0;
+	int integers = 1;
+	while( !at_eol( &t ) ) {
+		const char *start = t.p;
+		while( *t.p != '\0' && *t.p != '\n' && *t.p != ' ' && *t.p != '\t' && *t.p != '\r' ) {
+			if( *t.p < '0' || *t.p > '9' )
+				integers = 0;
+			++t.p;
+		}
+		if( t.p == start )
+			break;
+		++tokens;
+	}
+	return tokens == 2 && integers ? FORMAT_EDGES : FORMAT_DENSE;
+}
+
+int graph_load( const char *path, enum graph_format format, struct graph *g ) {
+	if( format == FORMAT_BINARY || (format == FORMAT_AUTO && binfile_detect( path )) )
+		return binfile_map( path, g );
+	size_t length;
+	char *text = slurp( path, &length );
+	if( text == NULL )
+		return -1;
+	if( format == FORMAT_AUTO )
+		format = detect( text );
+
+	struct tokenizer t = { text, path, 1 };
+	struct edges e = { 0, 0, NULL, NULL, NULL };
+	size_t n = 0;
+	int rc;
+	memset( g, 0, sizeof(*g) );
+	if( format == FORMAT_DENSE ) {
+		rc = parse_dense( &t, length, g );
+	} else {
+		rc = format == FORMAT_MTX ? parse_mtx( &t, &e, &n ) : parse_edges( &t, length, &e, &n );
+		free( text );
+		text = NULL;
+		if( rc == 0 && (rc = build_transition( g, n, &e )) != 0 )
+			fprintf( stderr, "%s: out of memory\n", path );
+	}
+	edges_free( &e );
+	free( text );
+	return rc;
+}
+
+int graph_from_edges( struct graph *g, size_t n, size_t m, const uint32_t *src, const uint32_t *dst ) {
+	memset( g, 0, sizeof(*g) );
+	const struct edges e = { m, m, (uint32_t *) src, (uint32_t *) dst, NULL };
+	return build_transition( g, n, &e );
+}
+
+int graph_from_dense( struct graph *g, size_t n, const double *dense ) {
+	memset( g, 0, sizeof(*g) );
+	if( csr_from_dense( &g->A, n, dense ) != 0 || find_deficits( g ) != 0 ) {
+		graph_free( g );
+		return -1;
+	}
+	return 0;
+}
+
+void graph_free( struct graph *g ) {
+	if( g->map != NULL ) {
+		munmap( g->map, g->map_length );
+		memset( g, 0, sizeof(*g) );
+		return;
+	}
+	csr_free( &g->A );
+	free( g->dangling );
+	free( g->deficit );
+	g->dangling = NULL;
+	g->deficit = NULL;
+	g->ndangling = 0;
+}
+
+int graph_delta_load( const char *path, struct graph_delta *d ) {
+	memset( d, 0, sizeof(*d) );
+	size_t length;
+	char *text = slurp( path, &length );
+	if( text == NULL )
+		return -1;
+	struct tokenizer t = { text, path, 1 };
+	size_t cap = 1024;
+	int rc = 0;
+	d->src = malloc( cap * sizeof(uint32_t) );
+	d->dst = malloc( cap * sizeof(uint32_t) );
+	d->insert = malloc( cap );
+	if( d->src == NULL || d->dst == NULL || d->insert == NULL )
+		rc = parse_error( &t, "out of memory" );
+	while( rc == 0 ) {
+		skip_comments( &t, '#' );
+		if( *t.p == '\0' )
+			break;
+		const char op = *t.p++;
+		uint64_t s, e;
+		if( op != '+' && op != '-' ) {
+			rc = parse_error( &t, "expected `+' or `-'" );
+			break;
+		}
+		if( next_uint( &t, &s ) != 0 || next_uint( &t, &e ) != 0 ) {
+			rc = -1;
+			break;
+		}
+		if( s >= UINT32_MAX || e >= UINT32_MAX ) {
+			rc = parse_error( &t, "node id does not fit in 32 bits" );
+			break;
+		}
+		if( d->count == cap ) {
+			cap *= 2;
+			uint32_t *src = realloc( d->src, cap * sizeof(uint32_t) );
+			if( src != NULL )
+				d->src = src;
+			uint32_t *dst = realloc( d->dst, cap * sizeof(uint32_t) );
+			if( dst != NULL )
+				d->dst = dst;
+			unsigned char *insert = realloc( d->insert, cap );
+			if( insert != NULL )
+				d->insert = insert;
+			if( src == NULL || dst == NULL || insert == NULL ) {
+				rc = parse_error( &t, "out of memory" );
+				break;
+			}
+		}
+		d->src[ d->count ] = s;
+		d->dst[ d->count ] = e;
+		d->insert[ d->count++ ] = op == '+';
+		next_line( &t );
+	}
+	free( text );
+	if( rc != 0 )
+		graph_delta_free( d );
+	return rc;
+}
+
+void graph_delta_free( struct graph_delta *d ) {
+	free( d->src );
+	free( d->dst );
+	free( d->insert );
+	memset( d, 0, sizeof(*d) );
+}
+
+//a change of entry (dst, src) of the transition matrix; seq keeps the file
+//order among changes of the same edge
+struct change {
+	uint32_t row;
+	uint32_t col;
+	size_t seq;
+	int insert;
+};
+
+static int compare_changes( const void *a, const void *b ) {
+	const struct change *x = a, *y = b;
+	if( x->row != y->row )
+		return x->row < y->row ? -1 : 1;
+	if( x->col != y->col )
+		return x->col < y->col ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+int graph_apply_delta( struct graph *g, const struct graph_delta *d, struct delta_stats *stats ) {
+	memset( stats, 0, sizeof(*stats) );
+	const struct csr *A = &g->A;
+	size_t n = A->n;
+	for( size_t k = 0; k < d->count; ++k ) {
+		if( d->src[ k ] >= n ) n = d->src[ k ] + 1;
+		if( d->dst[ k ] >= n ) n = d->dst[ k ] + 1;
+	}
+	struct change *changes = malloc( (d->count ? d->count : 1) * sizeof(struct change) );
+	uint64_t *outdeg = calloc( n ? n : 1, sizeof(uint64_t) );
+	unsigned char *affected = calloc( n ? n : 1, 1 );
+	//per column the mean weight of its out-links before, then the sum of
+	//its weights after the changes
+	double *share = calloc( n ? n : 1, sizeof(double) );
+	double *sum = calloc( n ? n : 1, sizeof(double) );
+	struct graph next;
+	memset( &next, 0, sizeof(next) );
+	int rc = -1;
+	if( changes == NULL || outdeg == NULL || affected == NULL || share == NULL || sum == NULL )
+		goto out;
+	size_t inserts = 0;
+	for( size_t k = 0; k < d->count; ++k ) {
+		changes[ k ] = (struct change) { d->dst[ k ], d->src[ k ], k, d->insert[ k ] };
+		inserts += d->insert[ k ];
+	}
+	qsort( changes, d->count, sizeof(struct change), compare_changes );
+	for( size_t k = 0; k < A->nnz; ++k ) {
+		++outdeg[ A->col[ k ] ];
+		share[ A->col[ k ] ] += A->val[ k ];
+	}
+	for( size_t j = 0; j < n; ++j )
+		share[ j ] = outdeg[ j ] > 0 && share[ j ] > 0.0 ? share[ j ] / outdeg[ j ] : 1.0;
+	if( csr_alloc( &next.A, n, A->nnz + inserts ) != 0 )
+		goto out;
+
+	//merge every row with its changes, both sorted by column; only the
+	//last change of an edge counts
+	struct csr *B = &next.A;
+	size_t nnz = 0, c = 0;
+	for( size_t i = 0; i < n; ++i ) {
+		uint64_t k = i < A->n ? A->row_start[ i ] : 0;
+		const uint64_t end = i < A->n ? A->row_start[ i + 1 ] : 0;
+		for( ;; ) {
+			while( c + 1 < d->count && changes[ c + 1 ].row == changes[ c ].row && changes[ c + 1 ].col == changes[ c ].col )
+				++c;
+			const int have_change = c < d->count && changes[ c ].row == i;
+			if( k == end && !have_change )
+				break;
+			if( !have_change || (k < end && A->col[ k ] < changes[ c ].col) ) {
+				B->col[ nnz ] = A->col[ k ];
+				B->val[ nnz++ ] = A->val[ k++ ];
+				continue;
+			}
+			const uint32_t j = changes[ c ].col;
+			const int present = k < end && A->col[ k ] == j;
+			if( changes[ c ].insert ) {
+				if( present ) {
+					B->col[ nnz ] = j;
+					B->val[ nnz++ ] = A->val[ k ];
+				} else {
+					B->col[ nnz ] = j;
+					B->val[ nnz++ ] = share[ j ];
+					++outdeg[ j ];
+					affected[ j ] = 1;
+					++stats->inserted;
+				}
+			} else if( present ) {
+				--outdeg[ j ];
+				affected[ j ] = 1;
+				++stats->deleted;
+			}
+			k += present;
+			++c;
+		}
+		B->row_start[ i + 1 ] = nnz;
+	}
+	B->nnz = nnz;
+
+	//a changed column keeps the proportions of its weights and its sum,
+	//unless it had no out-links, when it becomes stochastic, or lost them
+	//all, when it is dangling. An unchanged one keeps its state and a new
+	//node starts without out-links.
+	size_t listed = 0;
+	for( size_t j = 0, k = 0; j < n; ++j ) {
+		while( k < g->ndangling && g->dangling[ k ] < j )
+			++k;
+		const int old = j < A->n && k < g->ndangling && g->dangling[ k ] == j;
+		stats->columns += affected[ j ];
+		if( affected[ j ] ) {
+			const int deficit = old && g->deficit != NULL && g->deficit[ k ] != 1.0;
+			sum[ j ] = deficit ? 1.0 - g->deficit[ k ] : 1.0;
+			listed += outdeg[ j ] == 0 || deficit;
+		} else {
+			listed += j >= A->n || old;
+		}
+	}
+	for( size_t k = 0; k < nnz; ++k )
+		if( affected[ B->col[ k ] ] )
+			share[ B->col[ k ] ] = 0.0;
+	for( size_t k = 0; k < nnz; ++k )
+		if( affected[ B->col[ k ] ] )
+			share[ B->col[ k ] ] += B->val[ k ];
+	for( size_t k = 0; k < nnz; ++k )
+		if( affected[ B->col[ k ] ] )
+			B->val[ k ] *= sum[ B->col[ k ] ] / share[ B->col[ k ] ];
+	next.ndangling = listed;
+	next.dangling = malloc( (listed ? listed : 1) * sizeof(uint32_t) );
+	if( g->deficit != NULL )
+		next.deficit = malloc( (listed ? listed : 1) * sizeof(double) );
+	if( next.dangling == NULL || (g->deficit != NULL && next.deficit == NULL) ) {
+		graph_free( &next );
+		goto out;
+	}
+	for( size_t j = 0, k = 0, m = 0; j < n; ++j ) {
+		while( k < g->ndangling && g->dangling[ k ] < j )
+			++k;
+		const int old = j < A->n && k < g->ndangling && g->dangling[ k ] == j;
+		const int deficit = old && g->deficit != NULL && g->deficit[ k ] != 1.0;
+		if( affected[ j ] ? outdeg[ j ] == 0 || deficit : j >= A->n || old ) {
+			next.dangling[ m ] = j;
+			if( next.deficit != NULL )
+				next.deficit[ m ] = old && (!affected[ j ] || outdeg[ j ] > 0) ? g->deficit[ k ] : 1.0;
+			++m;
+		}
+	}
+	stats->added = n - A->n;
+	graph_free( g );
+	*g = next;
+	rc = 0;
+out:
+	free( changes );
+	free( outdeg );
+	free( affected );
+	free( share );
+	free( sum );
+	return rc;
+}
+
+int vector_load( const char *path, size_t n, double *x ) {
+	size_t length;
+	char *text = slurp( path, &length );
+	if( text == NULL )
+		return -1;
+	struct tokenizer t = { text, path, 1 };
+	size_t count = 0;
+	int rc = 0;
+	for( ;; ) {
+		skip_comments( &t, '#' );
+		if( *t.p == '\0' )
+			break;
+		double v;
+		if( count == n ) {
+			rc = parse_error( &t, "more entries than the graph has nodes" );
+			break;
+		}
+		if( (rc = next_double( &t, &v )) != 0 )
+			break;
+		if( !(v >= 0.0) ) {
+			rc = parse_error( &t, "rank must not be negative" );
+			break;
+		}
+		x[ count++ ] = v;
+		next_line( &t );
+	}
+	free( text );
+	if( rc != 0 )
+		return -1;
+	for( size_t i = count; i < n; ++i )
+		x[ i ] = 1.0 / n;
+	double sum = 0.0;
+	for( size_t i = 0; i < n; ++i )
+		sum += x[ i ];
+	if( !(sum > 0.0) ) {
+		fprintf( stderr, "%s: the ranks do not add up to a positive total\n", path );
+		return -1;
+	}
+	for( size_t i = 0; i < n; ++i )
+		x[ i ] /= sum;
+	return 0;
+}
+
+int vector_save( const char *path, size_t n, const double *x ) {
+	FILE *file = fopen( path, "w" );
+	if( file == NULL ) {
+		perror( path );
+		return -1;
+	}
+	int rc = 0;
+	for( size_t i = 0; i < n && rc == 0; ++i )
+		rc = fprintf( file, "%.17g\n", x[ i ] ) < 0 ? -1 : 0;
+	if( fclose( file ) != 0 )
+		rc = -1;
+	if( rc != 0 )
+		fprintf( stderr, "%s: write failed\n", path );
+	return rc;
+}
+
+int partition_load( const char *path, size_t n, unsigned int P, uint32_t *part ) {
+	size_t length;
+	char *text = slurp( path, &length );
+	if( text == NULL )
+		return -1;
+	struct tokenizer t = { text, path, 1 };
+	size_t count = 0;
+	int rc = 0;
+	for( ;; ) {
+		skip_comments( &t, '#' );
+		if( *t.p == '\0' )
+			break;
+		uint64_t s;
+		if( count == n ) {
+			rc = parse_error( &t, "more lines than the graph has nodes" );
+			break;
+		}
+		if( (rc = next_uint( &t, &s )) != 0 )
+			break;
+		if( s >= P ) {
+			fprintf( stderr, "%s:%zu: expected a processor below %u\n", path, t.line, P );
+			rc = -1;
+			break;
+		}
+		part[ count++ ] = s;
+		next_line( &t );
+	}
+	free( text );
+	if( rc == 0 && count != n ) {
+		fprintf( stderr, "%s: %zu lines for %zu nodes\n", path, count, n );
+		rc = -1;
+	}
+	return rc;
+}
+
+int partition_save( const char *path, size_t n, const uint32_t *part ) {
+	FILE *file = fopen( path, "w" );
+	if( file == NULL ) {
+		perror( path );
+		return -1;
+	}
+	int rc = 0;
+	for( size_t v = 0; v < n && rc == 0; ++v )
+		rc = fprintf( file, "%u\n", part[ v ] ) < 0 ? -1 : 0;
+	if( fclose( file ) != 0 )
+		rc = -1;
+	if( rc != 0 )
+		fprintf( stderr, "%s: write failed\n", path );
+	return rc;
+}
+
+struct seed {
+	uint32_t vector;
+	uint32_t node;
+	double weight;
+};
+
+static int compare_seeds( const void *a, const void *b ) {
+	const struct seed *x = a, *y = b;
+	if( x->vector != y->vector )
+		return x->vector < y->vector ? -1 : 1;
+	return x->node < y->node ? -1 : x->node > y->node;
+}
+
+//reads `node [weight]' lines, or `vector node [weight]' lines if batched
+static int parse_seeds( struct tokenizer *t, size_t n, int batched, struct seed **seeds, size_t *count ) {
+	size_t cap = 16;
+	*count = 0;
+	*seeds = malloc( cap * sizeof(struct seed) );
+	if( *seeds == NULL )
+		return parse_error( t, "out of memory" );
+	for( ;; ) {
+		skip_comments( t, '#' );
+		if( *t->p == '\0' )
+			return 0;
+		uint64_t vector = 0, node;
+		double weight = 1.0;
+		if( (batched && next_uint( t, &vector ) != 0) || next_uint( t, &node ) != 0 || (!at_eol( t ) && next_double( t, &weight ) != 0) )
+			return -1;
+		if( vector >= UINT32_MAX )
+			return parse_error( t, "vector number out of range" );
+		if( node >= n )
+			return parse_error( t, "node id is not in the graph" );
+		if( !(weight >= 0.0) )
+			return parse_error( t, "weight must not be negative" );
+		if( *count == cap ) {
+			cap *= 2;
+			struct seed *grown = realloc( *seeds, cap * sizeof(struct seed) );
+			if( grown == NULL )
+				return parse_error( t, "out of memory" );
+			*seeds = grown;
+		}
+		(*seeds)[ (*count)++ ] = (struct seed) { vector, node, weight };
+		next_line( t );
+	}
+}
+
+//builds one personalization vector from seeds sorted by node, merging
+//repeated nodes; returns -1 if the weights do not have a positive total
+static int build_personalization( const struct seed *seeds, size_t count, struct personalization *p ) {
+	memset( p, 0, sizeof(*p) );
+	p->node = malloc( (count ? count : 1) * sizeof(uint32_t) );
+	p->weight = malloc( (count ? count : 1) * sizeof(double) );
+	if( p->node == NULL || p->weight == NULL ) {
+		personalization_free( p );
+		return -1;
+	}
+	double sum = 0.0;
+	for( size_t k = 0; k < count; ++k ) {
+		if( p->count > 0 && p->node[ p->count - 1 ] == seeds[ k ].node ) {
+			p->weight[ p->count - 1 ] += seeds[ k ].weight;
+		} else {
+			p->node[ p->count ] = seeds[ k ].node;
+			p->weight[ p->count++ ] = seeds[ k ].weight;
+		}
+		sum += seeds[ k ].weight;
+	}
+	if( !(sum > 0.0) ) {
+		personalization_free( p );
+		return -1;
+	}
+	for( size_t k = 0; k < p->count; ++k )
+		p->weight[ k ] /= sum;
+	return 0;
+}
+
+static int load_seeds( const char *path, size_t n, int batched, struct seed **seeds, size_t *count ) {
+	size_t length;
+	char *text = slurp( path, &length );
+	if( text == NULL )
+		return -1;
+	struct tokenizer t = { text, path, 1 };
+	int rc = parse_seeds( &t, n, batched, seeds, count );
+	free( text );
+	if( rc != 0 ) {
+		free( *seeds );
+		return -1;
+	}
+	qsort( *seeds, *count, sizeof(struct seed), compare_seeds );
+	return 0;
+}
+
+int personalization_load( const char *path, size_t n, struct personalization *p ) {
+	struct seed *seeds;
+	size_t count;
+	memset( p, 0, sizeof(*p) );
+	if( load_seeds( path, n, 0, &seeds, &count ) != 0 )
+		return -1;
+	const int rc = build_personalization( seeds, count, p );
+	if( rc != 0 )
+		fprintf( stderr, "%s: the weights do not add up to a positive total\n", path );
+	free( seeds );
+	return rc;
+}
+
+int personalization_load_batch( const char *path, size_t n, unsigned int *k, struct personalization **v ) {
+	struct seed *seeds;
+	size_t count;
+	*k = 0;
+	*v = NULL;
+	if( load_seeds( path, n, 1, &seeds, &count ) != 0 )
+		return -1;
+	const unsigned int nvectors = count ? seeds[ count - 1 ].vector + 1 : 0;
+	struct personalization *vectors = calloc( nvectors ? nvectors : 1, sizeof(struct personalization) );
+	if( vectors == NULL ) {
+		fprintf( stderr, "%s: out of memory\n", path );
+		free( seeds );
+		return -1;
+	}
+	int rc = nvectors > 0 ? 0 : -1;
+	for( size_t first = 0, last; first < count && rc == 0; first = last ) {
+		for( last = first + 1; last < count && seeds[ last ].vector == seeds[ first ].vector; ++last )
+			;
+		rc = build_personalization( seeds + first, last - first, vectors + seeds[ first ].vector );
+	}
+	for( unsigned int j = 0; j < nvectors && rc == 0; ++j )
+		if( vectors[ j ].count == 0 )
+			rc = -1;
+	free( seeds );
+	if( rc != 0 ) {
+		fprintf( stderr, "%s: every vector from 0 up needs seeds with a positive total weight\n", path );
+		personalization_free_batch( nvectors, vectors );
+		return -1;
+	}
+	*k = nvectors;
+	*v = vectors;
+	return 0;
+}
+
+void personalization_free( struct personalization *p ) {
+	free( p->node );
+	free( p->weight );
+	memset( p, 0, sizeof(*p) );
+}
+
+void personalization_free_batch( unsigned int k, struct personalization *v ) {
+	for( unsigned int j = 0; j < k && v != NULL; ++j )
+		personalization_free( v + j );
+	free( v );
+}
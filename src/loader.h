@@ -0,0 +1,128 @@
+#ifndef _H_LOADER
+#define _H_LOADER
+
+#include "csr.h"
+
+enum graph_format {
+	//pick the format from the file contents
+	FORMAT_AUTO = 0,
+	//SNAP-style edge list: one whitespace separated `src dst' pair per line,
+	//lines starting with '#' are comments
+	FORMAT_EDGES,
+	//MatrixMarket coordinate file, entry (i,j) is an edge from i to j
+	FORMAT_MTX,
+	//dense row-major matrix of doubles, used as the transition matrix as is
+	FORMAT_DENSE,
+	//binary CSR file written by the converter, mapped instead of parsed
+	FORMAT_BINARY
+};
+
+//a loaded graph: the transition matrix plus the nodes whose column does not
+//sum to one. The rank such a node fails to pass on along its out-links is
+//spread back by the engine as a rank-one correction, so no nonzeros are added.
+struct graph {
+	struct csr A;
+	//ascending; nodes without out-links and, for matrices given as is,
+	//nodes whose column sum differs from one
+	size_t ndangling;
+	uint32_t *dangling;
+	//per listed node the share of its rank that leaves the matrix, one minus
+	//its column sum; NULL if that is 1 for all of them
+	double *deficit;
+	//non-NULL if the arrays above point into a read-only mapped binary file
+	void *map;
+	size_t map_length;
+};
+
+//sparse teleport distribution for personalized PageRank: the weights of the
+//seed nodes, ascending by node and summing to one
+struct personalization {
+	size_t count;
+	uint32_t *node;
+	double *weight;
+};
+
+//parses a format name as given on the command line, returns -1 if unknown
+int graph_format_parse( const char *name, enum graph_format *format );
+
+//loads a graph from a text or binary file; sizes are taken from the file.
+//Returns 0 on success, otherwise prints a diagnostic to stderr and returns -1.
+int graph_load( const char *path, enum graph_format format, struct graph *g );
+
+//builds a graph on n nodes from the m edges src[k] -> dst[k], as for an edge
+//list file; returns 0 on success, -1 if out of memory
+int graph_from_edges( struct graph *g, size_t n, size_t m, const uint32_t *src, const uint32_t *dst );
+
+//turns the n x n dense row-major array into a graph, used as the transition
+//matrix as is
+int graph_from_dense( struct graph *g, size_t n, const double *dense );
+
+void graph_free( struct graph *g );
+
+//a batch of changes to an unweighted graph, in file order
+struct graph_delta {
+	size_t count;
+	uint32_t *src;
+	uint32_t *dst;
+	//1 if edge src->dst is inserted, 0 if it is deleted
+	unsigned char *insert;
+};
+
+//what applying a delta changed
+struct delta_stats {
+	size_t inserted;
+	size_t deleted;
+	//nodes whose out-links changed, so their whole column was rescaled
+	size_t columns;
+	//nodes the graph grew by
+	size_t added;
+};
+
+//reads one `+ src dst' (insertion) or `- src dst' (deletion) line per change,
+//'#' starts a comment. Returns 0 on success, otherwise prints a diagnostic to
+//stderr and returns -1.
+int graph_delta_load( const char *path, struct graph_delta *d );
+
+void graph_delta_free( struct graph_delta *d );
+
+//applies d to g: inserting an edge that exists or deleting one that does not
+//changes nothing, and where one edge changes twice the last change wins.
+//Nodes beyond the graph are added. An inserted edge weighs the mean of the
+//other out-links of its source, and every column whose out-links changed is
+//rescaled to its former sum, so weights keep their proportions and on an
+//unweighted graph each out-link gets the same share. All other nonzeros are
+//copied unchanged; the dangling list follows.
+//Returns 0 on success, or -1 if out of memory with g left unchanged.
+int graph_apply_delta( struct graph *g, const struct graph_delta *d, struct delta_stats *stats );
+
+//reads a rank vector, one value per line with '#' comments, into x. The file
+//may be shorter than n, as for a vector of a graph that has since grown;
+//missing entries start at 1/n. x is scaled to sum to one. Returns 0 on
+//success, otherwise prints a diagnostic to stderr and returns -1.
+int vector_load( const char *path, size_t n, double *x );
+
+//writes x one value per line at full precision, returns 0 on success
+int vector_save( const char *path, size_t n, const double *x );
+
+//reads one part per line, line i for node i, '#' starts a comment; every
+//part must be below P. Returns 0 on success, otherwise prints a diagnostic
+//to stderr and returns -1.
+int partition_load( const char *path, size_t n, unsigned int P, uint32_t *part );
+
+//writes part one per line, returns 0 on success
+int partition_save( const char *path, size_t n, const uint32_t *part );
+
+//reads one `node [weight]' pair per line, '#' starts a comment and the
+//weight defaults to 1. Repeated nodes are merged and the weights normalised.
+//Returns 0 on success, otherwise prints a diagnostic to stderr and returns -1.
+int personalization_load( const char *path, size_t n, struct personalization *p );
+
+//the same for a batch of vectors from `vector node [weight]' lines; vectors
+//are numbered from 0 and each needs at least one seed
+int personalization_load_batch( const char *path, size_t n, unsigned int *k, struct personalization **v );
+
+void personalization_free( struct personalization *p );
+
+void personalization_free_batch( unsigned int k, struct personalization *v );
+
+#endif
@@ -0,0 +1,117 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "numa.h"
+
+#include <mcbsp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+//node ids probed in sysfs; they may have gaps
+#define NUMA_MAX_NODES 1024
+//bytes read per bandwidth measurement, at least
+#define NUMA_PROBE_BYTES (64 << 20)
+
+//keeps the probe sums alive
+static volatile double sink;
+
+//adds the cores in a cpulist such as "0-3,8-11" to cpu, tagged with node;
+//returns the new count
+static size_t read_cpulist( FILE *file, int node, size_t *cpu, int *cpu_node, size_t count, size_t capacity ) {
+	unsigned long first, last;
+	int c;
+	while( fscanf( file, "%lu", &first ) == 1 ) {
+		last = first;
+		c = fgetc( file );
+		if( c == '-' && fscanf( file, "%lu", &last ) == 1 )
+			c = fgetc( file );
+		for( unsigned long k = first; k <= last && count < capacity; ++k ) {
+			cpu[ count ] = k;
+			cpu_node[ count++ ] = node;
+		}
+		if( c != ',' )
+			break;
+	}
+	return count;
+}
+
+unsigned int numa_pinning( unsigned int P, size_t *cpu, int *node, int *short_node ) {
+	//the cores of every node, grouped by node in ascending order
+	const long configured = sysconf( _SC_NPROCESSORS_CONF );
+	const size_t capacity = configured > 0 ? configured : 1;
+	size_t *cores = malloc( capacity * sizeof(size_t) );
+	int *core_node = malloc( capacity * sizeof(int) );
+	//group_start[g] is the first core of the g-th node that has cores
+	size_t *group_start = malloc( (capacity + 1) * sizeof(size_t) );
+	if( cores == NULL || core_node == NULL || group_start == NULL ) {
+		free( cores );
+		free( core_node );
+		free( group_start );
+		return 0;
+	}
+	size_t ncores = 0;
+	unsigned int nnodes = 0;
+	for( int k = 0; k < NUMA_MAX_NODES; ++k ) {
+		char path[ 64 ];
+		snprintf( path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", k );
+		FILE *file = fopen( path, "r" );
+		if( file == NULL )
+			continue;
+		const size_t before = ncores;
+		ncores = read_cpulist( file, k, cores, core_node, ncores, capacity );
+		fclose( file );
+		//nodes with memory only take no processors
+		if( ncores > before )
+			group_start[ nnodes++ ] = before;
+	}
+	if( nnodes == 0 ) {
+		const long online = sysconf( _SC_NPROCESSORS_ONLN );
+		for( ncores = 0; ncores < (online > 0 ? (size_t) online : 1) && ncores < capacity; ++ncores ) {
+			cores[ ncores ] = ncores;
+			core_node[ ncores ] = 0;
+		}
+		group_start[ nnodes++ ] = 0;
+	}
+	group_start[ nnodes ] = ncores;
+
+	//processor s goes to the (s * nnodes / P)-th node, on its next free core
+	unsigned int used = 0;
+	for( unsigned int s = 0, g = 0, index = 0; s < P; ++s, ++index ) {
+		if( s == 0 || (unsigned long) s * nnodes / P != g ) {
+			g = (unsigned long) s * nnodes / P;
+			index = 0;
+			++used;
+		}
+		if( group_start[ g ] + index >= group_start[ g + 1 ] ) {
+			*short_node = core_node[ group_start[ g ] ];
+			used = 0;
+			break;
+		}
+		cpu[ s ] = cores[ group_start[ g ] + index ];
+		node[ s ] = core_node[ group_start[ g ] + index ];
+	}
+	free( cores );
+	free( core_node );
+	free( group_start );
+	return used;
+}
+
+double numa_read_bandwidth( const double *a, size_t n ) {
+	if( n == 0 )
+		return 0.0;
+	const size_t passes = 1 + NUMA_PROBE_BYTES / (n * sizeof(double));
+	//independent sums, so that the additions keep up with memory
+	double sum[ 8 ] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+	const double start = bsp_time();
+	for( size_t p = 0; p < passes; ++p ) {
+		size_t i = 0;
+		for( ; i + 8 <= n; i += 8 )
+			for( unsigned int k = 0; k < 8; ++k )
+				sum[ k ] += a[ i + k ];
+		for( ; i < n; ++i )
+			sum[ 0 ] += a[ i ];
+	}
+	const double elapsed = bsp_time() - start;
+	sink = sum[ 0 ] + sum[ 1 ] + sum[ 2 ] + sum[ 3 ] + sum[ 4 ] + sum[ 5 ] + sum[ 6 ] + sum[ 7 ];
+	return elapsed > 0.0 ? passes * n * sizeof(double) / elapsed : 0.0;
+}
@@ -0,0 +1,24 @@
+#ifndef _H_NUMA
+#define _H_NUMA
+
+#include <stddef.h>
+
+//NUMA placement. Every processor is pinned to a core of its own, and
+//processors with consecutive ids, which own consecutive blocks of the vector
+//and exchange the most, share a node. Memory is placed on the node of the
+//thread that touches it first, so what a pinned processor allocates and
+//fills itself stays local to it.
+
+//the pinning of P processors: processor s goes to core cpu[s] on NUMA node
+//node[s], filling the nodes in order with about P / nodes processors each.
+//The topology is read from /sys/devices/system/node, or taken to be a single
+//node with all online cores where that is missing. Returns the number of
+//nodes used, or 0 if some node has fewer cores than the processors it would
+//take; *short_node is then the first such node.
+unsigned int numa_pinning( unsigned int P, size_t *cpu, int *node, int *short_node );
+
+//streaming read bandwidth over the n doubles of a, in bytes per second;
+//slices smaller than NUMA_PROBE_BYTES are read several times
+double numa_read_bandwidth( const double *a, size_t n );
+
+#endif
@@ -1,105 +1,391 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <mcbsp.h>
+#include <math.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
-static int count;
-static const double fudge_factor = 0.9;
-static double vector[4];
-static double vector_tmp[4];
+#include "csr.h"
+#include "loader.h"
+#include "engine.h"
+#include "checkpoint.h"
+#include "reorder.h"
+#include "partition.h"
 
-//initialisation function for ip
-void ip_init( double **ip_buffer ) {
-	const size_t size = bsp_nprocs() * sizeof(double);
-	*ip_buffer = malloc( size );
-	bsp_push_reg( *ip_buffer, size );
-}
+static const double test_matrix[4*4] = {0.2,0.2,0.5,0.0,0.2,0.2,0.0,0.0,0.2,0.2,0.0,0.0,0.2,0.2,0.0,1}; //test matrix
+static struct graph graph;
+static struct personalization personalization;
+//the vectors of a batched run
+static struct personalization *batch;
+static unsigned int nbatch;
+static struct engine_config config = { .damping = ENGINE_DAMPING, .tolerance = 1e-8, .max_iterations = 1000, .norm = NORM_L1, .distribution = DIST_1D, .checkpoint_interval = 10 };
 
-//calculates the inner-product from local vectors
-double ip( double *x, double *y, double *ip_buffer, size_t np ) {
-	double alpha = 0.0;
-	for( size_t i = 0; i < np; ++i ){
-		//printf("In thread %d: value of x[%d] = %f and y=[%d] = %f \n",bsp_pid(),i,x[i],i,y[i]);
-		alpha += fudge_factor * x[ i ] * y[ i ];
-	}
-	for( unsigned int k = 0; k < bsp_nprocs(); ++k ) {
-		bsp_put( k, &alpha, ip_buffer,bsp_pid()*sizeof(double), sizeof(double) );
-	}
-	bsp_sync();
-	for( unsigned int k = 1; k < bsp_nprocs(); ++k )
-		ip_buffer[ 0 ] += ip_buffer[ k ];
-	return ip_buffer[ 0 ];
+//moves entry i of the width interleaved vectors in x to perm[i], or with
+//inverse from perm[i] back to i; returns 0 on success
+static int permute_vector( size_t n, unsigned int width, const uint32_t *perm, double *x, int inverse ) {
+	double *copy = malloc( (n ? n * width : 1) * sizeof(double) );
+	if( copy == NULL )
+		return -1;
+	memcpy( copy, x, n * width * sizeof(double) );
+	for( size_t i = 0; i < n; ++i )
+		for( unsigned int j = 0; j < width; ++j ) {
+			if( inverse )
+				x[ i * width + j ] = copy[ perm[ i ] * width + j ];
+			else
+				x[ perm[ i ] * width + j ] = copy[ i * width + j ];
+		}
+	free( copy );
+	return 0;
 }
 
 //Vb: {{1,2,3}{4,5,6}{7,8,9}} --> {1,4,7,2,5,8,3,6,9}
 //deze functie vult een array met een geflattende 2D array volgens rij
-void fill_matrix(size_t M, double matrix[M*M]) {
+void fill_matrix(size_t n, double matrix[n*n]) {
 	unsigned int x,y;
-	for(x=0;x<M;x++){
-		for(y=0;y<M;y++){
-			matrix[x*M + y] = y*M + x;
+	for(x=0;x<n;x++){
+		for(y=0;y<n;y++){
+			matrix[x*n + y] = y*n + x;
 		}
 	}
 }
 
-void spmd() {
-	const size_t M = 4;
-	double matrix[] = {0.2,0.2,0.5,0.0,0.2,0.2,0.0,0.0,0.2,0.2,0.0,0.0,0.2,0.2,0.0,1}; //test matrix
-	//double matrix[M*M];
-	//fill_matrix(M, matrix);
+int main( int argc, char **argv ) {
 
-	bsp_begin( bsp_nprocs() );
-	double *ip_buffer, *x, *y;
-	size_t np;
-	ip_init( &ip_buffer );
-	np = M/bsp_nprocs();
-	//double x_array[] = {0.1,0.2,0.3,0.4,0.5,0.6,0.7,0.8,0.9,0.10,0.11,0.12};
-	x = vector+(bsp_pid()*np);
-	y = matrix;
-	y = y + count*M + (bsp_pid()*np);
-	bsp_sync();
+	enum graph_format format = FORMAT_AUTO;
+	const char *seeds = NULL;
+	const char *batch_file = NULL;
+	const char *delta_file = NULL;
+	const char *warm_file = NULL;
+	const char *output_file = NULL;
+	const char *resume = NULL;
+	enum ordering ordering = ORDER_NONE;
+	const char *partition_in = NULL;
+	const char *partition_out = NULL;
+	int opt;
+	int usage = 0;
+	while( (opt = getopt( argc, argv, "f:p:d:e:i:n:k:s:a:t:c:v:b:u:w:o:C:N:r:T:R:m:M:H:W:A" )) != -1 ) {
+		switch( opt ) {
+		case 'f':
+			usage |= graph_format_parse( optarg, &format ) != 0;
+			break;
+		case 'p':
+			config.nprocs = strtoul( optarg, NULL, 10 );
+			usage |= config.nprocs == 0;
+			break;
+		case 'd':
+			if( strcmp( optarg, "1d" ) == 0 )
+				config.distribution = DIST_1D;
+			else if( strcmp( optarg, "2d" ) == 0 )
+				config.distribution = DIST_2D;
+			else
+				usage = 1;
+			break;
+		case 'e':
+			config.tolerance = strtod( optarg, NULL );
+			break;
+		case 'i':
+			config.max_iterations = strtoul( optarg, NULL, 10 );
+			break;
+		case 'n':
+			if( strcmp( optarg, "l1" ) == 0 )
+				config.norm = NORM_L1;
+			else if( strcmp( optarg, "inf" ) == 0 )
+				config.norm = NORM_LINF;
+			else
+				usage = 1;
+			break;
+		case 's':
+			if( strcmp( optarg, "jacobi" ) == 0 )
+				config.solver = SOLVER_JACOBI;
+			else if( strcmp( optarg, "gs" ) == 0 )
+				config.solver = SOLVER_GAUSS_SEIDEL;
+			else
+				usage = 1;
+			break;
+		case 'a':
+			if( strcmp( optarg, "none" ) == 0 )
+				config.accel = ACCEL_NONE;
+			else if( strcmp( optarg, "aitken" ) == 0 )
+				config.accel = ACCEL_AITKEN;
+			else if( strcmp( optarg, "quadratic" ) == 0 )
+				config.accel = ACCEL_QUADRATIC;
+			else
+				usage = 1;
+			break;
+		case 't':
+			config.adaptive_threshold = strtod( optarg, NULL );
+			usage |= !(config.adaptive_threshold > 0.0 && isfinite( config.adaptive_threshold ));
+			break;
+		case 'c':
+			config.damping = strtod( optarg, NULL );
+			usage |= !(config.damping >= 0.0 && config.damping <= 1.0);
+			break;
+		case 'v':
+			seeds = optarg;
+			break;
+		case 'b':
+			batch_file = optarg;
+			break;
+		case 'u':
+			delta_file = optarg;
+			break;
+		case 'w':
+			warm_file = optarg;
+			break;
+		case 'o':
+			output_file = optarg;
+			break;
+		case 'C':
+			config.checkpoint = optarg;
+			break;
+		case 'N':
+			config.checkpoint_interval = strtoul( optarg, NULL, 10 );
+			usage |= config.checkpoint_interval == 0;
+			break;
+		case 'r':
+			resume = optarg;
+			break;
+		case 'T':
+			config.report = optarg;
+			break;
+		case 'R':
+			usage |= ordering_parse( optarg, &ordering ) != 0;
+			break;
+		case 'm':
+			partition_in = optarg;
+			break;
+		case 'M':
+			partition_out = optarg;
+			break;
+		case 'H':
+			config.split_rows = strtod( optarg, NULL );
+			usage |= !(config.split_rows > 0.0);
+			break;
+		case 'W':
+			config.chunks = strtoul( optarg, NULL, 10 );
+			usage |= config.chunks < 2;
+			break;
+		case 'A':
+			config.numa = 1;
+			break;
+		case 'k':
+			usage |= kernel_parse( optarg, &config.kernel ) != 0;
+			break;
+		default:
+			usage = 1;
+		}
+	}
+	//Gauss-Seidel updates rows in place and the adaptive mode freezes them,
+	//so both need each row on its owner
+	usage |= (config.solver == SOLVER_GAUSS_SEIDEL || config.adaptive_threshold > 0.0) && (config.distribution == DIST_2D || config.split_rows > 0.0);
+	//stealing shares out products, not sweeps
+	usage |= config.solver == SOLVER_GAUSS_SEIDEL && config.chunks > 1;
+	//2D already spreads every row over a grid row
+	usage |= config.split_rows > 0.0 && config.distribution == DIST_2D;
+	//a batch only takes plain power-method steps
+	usage |= batch_file != NULL && (seeds != NULL || config.solver != SOLVER_JACOBI || config.accel != ACCEL_NONE || config.adaptive_threshold > 0.0);
+	//vector files hold a single vector
+	usage |= batch_file != NULL && (warm_file != NULL || output_file != NULL || config.checkpoint != NULL || resume != NULL);
+	usage |= warm_file != NULL && resume != NULL;
+	usage |= partition_in != NULL && partition_out != NULL;
+	if( usage ) {
+		fprintf( stderr, "Usage: %s [-f auto|edges|mtx|dense|bin] [-p processors] [-d 1d|2d] [-e tolerance] [-i max iterations] [-n l1|inf] [-s jacobi|gs] [-a none|aitken|quadratic] [-t adaptive threshold] [-c damping] [-v personalization file] [-b batch file] [-u edge delta file] [-w start vector file] [-o vector output file] [-C checkpoint path] [-N checkpoint interval] [-r checkpoint to resume] [-T report.json|report.csv] [-R none|degree|rcm|gorder] [-m partition file | -M partition output file] [-H split row factor] [-W chunks per processor] [-A] [-k auto|scalar|sse2|avx2|avx512] [graph file]\n", argv[ 0 ] );
+		return EXIT_FAILURE;
+	}
 
-	//printf("1e element(k=%d) in thread %d van y= %f\n",k,bsp_pid(),*y);
-	double alpha = ip( x, y, ip_buffer, np );
-	alpha+= 0.1*((double) 1/M); // this is now the vector-matrix product of pi(stationary vector and P (stochastic matrix) + E
-	//printf("alpha thread %d = %f met k=%d\n",bsp_pid(),alpha,count);
-	
-	//printf("alpha van thread %d = %f.(k= %d)\n",bsp_pid(),alpha,k);
-	bsp_end();
-	vector_tmp[count] = alpha;
-}
+	if( optind < argc ) {
+		if( graph_load( argv[ optind ], format, &graph ) != 0 )
+			return EXIT_FAILURE;
+	} else if( graph_from_dense( &graph, 4, test_matrix ) != 0 ) {
+		fprintf( stderr, "Out of memory\n" );
+		return EXIT_FAILURE;
+	}
+	struct delta_stats delta_stats;
+	if( delta_file != NULL ) {
+		struct graph_delta delta;
+		if( graph_delta_load( delta_file, &delta ) != 0 )
+			return EXIT_FAILURE;
+		const int rc = graph_apply_delta( &graph, &delta, &delta_stats );
+		graph_delta_free( &delta );
+		if( rc != 0 ) {
+			fprintf( stderr, "Out of memory\n" );
+			return EXIT_FAILURE;
+		}
+	}
+	const size_t size = graph.A.n;
+	//the engine runs on the renumbered graph; node ids read from files are
+	//mapped to the new ids and the results mapped back
+	uint32_t *perm = NULL;
+	double gap_before = 0.0;
+	if( ordering != ORDER_NONE ) {
+		perm = malloc( (size ? size : 1) * sizeof(uint32_t) );
+		gap_before = average_column_gap( &graph.A );
+		if( perm == NULL || reorder_compute( &graph, ordering, perm ) != 0 || graph_permute( &graph, perm ) != 0 ) {
+			fprintf( stderr, "Out of memory\n" );
+			return EXIT_FAILURE;
+		}
+	}
+	if( config.nprocs == 0 )
+		config.nprocs = bsp_nprocs();
+	//a partition assigns every node to a processor; its parts are made
+	//contiguous by a second renumbering, applied after any ordering
+	size_t *starts = NULL;
+	size_t volume_before = 0, volume_after = 0;
+	if( partition_in != NULL || partition_out != NULL ) {
+		const unsigned int P = config.nprocs;
+		uint32_t *part = malloc( (size ? size : 1) * sizeof(uint32_t) );
+		uint32_t *file_part = malloc( (size ? size : 1) * sizeof(uint32_t) );
+		uint32_t *part_perm = malloc( (size ? size : 1) * sizeof(uint32_t) );
+		starts = malloc( (P + 1) * sizeof(size_t) );
+		if( perm == NULL ) {
+			perm = malloc( (size ? size : 1) * sizeof(uint32_t) );
+			for( size_t v = 0; perm != NULL && v < size; ++v )
+				perm[ v ] = v;
+		}
+		if( part == NULL || file_part == NULL || part_perm == NULL || starts == NULL || perm == NULL ) {
+			fprintf( stderr, "Out of memory\n" );
+			return EXIT_FAILURE;
+		}
+		//files hold the parts by original id
+		if( partition_in != NULL ) {
+			if( partition_load( partition_in, size, P, file_part ) != 0 )
+				return EXIT_FAILURE;
+			for( size_t v = 0; v < size; ++v )
+				part[ perm[ v ] ] = file_part[ v ];
+		} else {
+			if( partition_label_propagation( &graph, P, part ) != 0 ) {
+				fprintf( stderr, "Out of memory\n" );
+				return EXIT_FAILURE;
+			}
+			for( size_t v = 0; v < size; ++v )
+				file_part[ v ] = part[ perm[ v ] ];
+			if( partition_save( partition_out, size, file_part ) != 0 )
+				return EXIT_FAILURE;
+		}
+		volume_after = partition_volume( &graph.A, P, part );
+		if( partition_nonzeros( &graph.A, P, file_part ) != 0 ) {
+			fprintf( stderr, "Out of memory\n" );
+			return EXIT_FAILURE;
+		}
+		volume_before = partition_volume( &graph.A, P, file_part );
+		partition_order( size, P, part, part_perm, starts );
+		if( graph_permute( &graph, part_perm ) != 0 ) {
+			fprintf( stderr, "Out of memory\n" );
+			return EXIT_FAILURE;
+		}
+		for( size_t v = 0; v < size; ++v )
+			perm[ v ] = part_perm[ perm[ v ] ];
+		config.starts = starts;
+		free( part );
+		free( file_part );
+		free( part_perm );
+	}
+	if( seeds != NULL ) {
+		if( personalization_load( seeds, size, &personalization ) != 0 )
+			return EXIT_FAILURE;
+		if( perm != NULL && personalization_permute( &personalization, perm ) != 0 ) {
+			fprintf( stderr, "Out of memory\n" );
+			return EXIT_FAILURE;
+		}
+		config.personalization = &personalization;
+	}
+	//a batch is written as one vector of width entries per node
+	unsigned int width = 1;
+	if( batch_file != NULL ) {
+		if( personalization_load_batch( batch_file, size, &nbatch, &batch ) != 0 )
+			return EXIT_FAILURE;
+		for( unsigned int j = 0; j < nbatch && perm != NULL; ++j )
+			if( personalization_permute( batch + j, perm ) != 0 ) {
+				fprintf( stderr, "Out of memory\n" );
+				return EXIT_FAILURE;
+			}
+		width = nbatch;
+	}
+	double *vector = malloc( (size ? size * width : 1) * sizeof(double) );
+	if( vector == NULL ) {
+		fprintf( stderr, "Out of memory\n" );
+		return EXIT_FAILURE;
+	}
 
-int main( int argc, char **argv ) {
+	//a warm start from an earlier result, typically of the graph before the
+	//delta, needs far fewer iterations than the uniform start
+	if( warm_file != NULL ) {
+		if( vector_load( warm_file, size, vector ) != 0 )
+			return EXIT_FAILURE;
+		if( perm != NULL && permute_vector( size, 1, perm, vector, 0 ) != 0 ) {
+			fprintf( stderr, "Out of memory\n" );
+			return EXIT_FAILURE;
+		}
+	} else if( resume != NULL ) {
+		//checkpoints hold the vector in the order of the run that wrote
+		//them, so the run resumes with the same -R and -m
+		double residual;
+		if( checkpoint_load( resume, size, vector, &config.first_iteration, &residual ) != 0 )
+			return EXIT_FAILURE;
+		printf("Resuming after iteration %u, residual %g\n", config.first_iteration, residual);
+	} else {
+		for(size_t l = 0;l < size * width;l++)
+			vector[l] = (double) 1/size;
+	}
 
-	#define BILLION  1E9
+	struct engine_stats stats;
+	if( batch_file != NULL )
+		pagerank_run_batch( &graph, &config, nbatch, batch, vector, &stats );
+	else
+		pagerank_run( &graph, &config, vector, &stats );
+	if( perm != NULL && permute_vector( size, width, perm, vector, 1 ) != 0 ) {
+		fprintf( stderr, "Out of memory\n" );
+		return EXIT_FAILURE;
+	}
 
-	const int size = 4;
-	
-	for(unsigned int l = 0;l < size;l++)
-		vector[l] = (double) 1/size;
+	//wall time measured by the processors themselves with bsp_time
+	printf("Time taken: %lfs (compute %lfs, communication %lfs, sync %lfs on the slowest processor)\n", stats.time, stats.compute, stats.comm, stats.sync);
+	printf("Iterations: %u (%u extrapolated), residual %g (%s)\n", stats.iterations, stats.extrapolations, stats.residual, stats.residual <= config.tolerance ? "converged" : "not converged");
+	printf("Communication: %zu vector entries and %zu partial sums in %zu requests per iteration on a %ux%u processor grid\n", stats.ghosts, stats.partials, stats.messages, stats.grid_rows, stats.grid_cols);
+	printf("Kernel: %s\n", kernel_name( stats.kernel ));
+	printf("Balance: the busiest processor has %.1f%% more work and %.1f%% more computation time than the mean\n", 100.0 * (stats.work_imbalance - 1.0), 100.0 * (stats.compute_imbalance - 1.0));
+	if( config.numa ) {
+		if( stats.numa_nodes == 0 )
+			printf("NUMA: node %d has fewer cores than its processors, not pinned\nNUMA: a", stats.numa_short_node);
+		else
+			printf("NUMA: pinned over %u node%s; a", stats.numa_nodes, stats.numa_nodes > 1 ? "s" : "");
+		printf(" processor reads its part of the matrix at %.2f GB/s", stats.local_bandwidth / 1e9);
+		if( stats.remote_bandwidth > 0.0 )
+			printf(" and %s at %.2f GB/s", stats.numa_nodes > 1 ? "one on another node" : "another processor's", stats.remote_bandwidth / 1e9);
+		printf("\n");
+	}
+	if( config.chunks > 1 )
+		printf("Stealing: %.1f chunks of %u per processor computed by another processor per iteration\n", stats.iterations ? (double) stats.stolen / ((double) stats.iterations * config.nprocs) : 0.0, config.chunks);
+	if( perm != NULL )
+		printf("Ordering: %s, average column gap %.1f before and %.1f after\n", ordering_name( ordering ), gap_before, average_column_gap( &graph.A ));
+	if( starts != NULL )
+		printf("Partition: %zu vector entries fetched per iteration with the default split, %zu with this one\n", volume_before, volume_after);
+	if( delta_file != NULL )
+		printf("Delta: %zu edges inserted, %zu deleted, %zu nodes with changed out-links, %zu nodes added\n", delta_stats.inserted, delta_stats.deleted, delta_stats.columns, delta_stats.added);
+	if( config.adaptive_threshold > 0.0 )
+		printf("Adaptive: %zu rows computed in %u iterations\n", stats.rows_computed, stats.iterations);
 
-	clock_t start = clock();
-	//start
-	for(unsigned int w = 0;w<50;w++){ // Power method
-		count = 0;
-		for(int k = 0;k < size;k++){
-			bsp_init( &spmd, argc, argv );
-			spmd();
-			count++;
+	for(size_t o = 0;o < size;o++) {
+		if( width == 1 ) {
+			printf("Stationary vector [%zu] = %f\n",o,vector[o]);
+			continue;
 		}
-		memcpy(&vector,&vector_tmp,8*size);
+		printf("Stationary vectors [%zu] =",o);
+		for( unsigned int j = 0; j < width; ++j )
+			printf(" %f", vector[ o * width + j ]);
+		printf("\n");
 	}
-	//end
-	clock_t end = clock();
 
-	// Calculate time it took
-	double elapsed = ((double) (end - start)) / CLOCKS_PER_SEC;
-	printf("Time taken: %lfs\n", elapsed);
+	if( output_file != NULL && vector_save( output_file, size, vector ) != 0 )
+		return EXIT_FAILURE;
 
-	for(unsigned int o = 0;o < size;o++)
-		printf("Stationary vector [%d] = %f\n",o,vector_tmp[o]);
+	free( vector );
+	free( perm );
+	free( starts );
+	personalization_free( &personalization );
+	personalization_free_batch( nbatch, batch );
+	graph_free( &graph );
+	return EXIT_SUCCESS;
 }
-
-
@@ -0,0 +1,170 @@
+#include "partition.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//how far a part's nonzeros may exceed the average
+#define PARTITION_IMBALANCE 0.03
+//sweeps over all nodes; label propagation settles within a few
+#define PARTITION_ROUNDS 10
+
+void partition_split( size_t n, const uint64_t *weight, unsigned int P, size_t *starts ) {
+	uint64_t total = 0;
+	for( size_t v = 0; v < n; ++v )
+		total += weight[ v ];
+	//block s starts at the first node whose middle lies past s / P of the
+	//total weight
+	uint64_t prefix = 0;
+	unsigned int s = 1;
+	starts[ 0 ] = 0;
+	for( size_t v = 0; v < n; ++v ) {
+		while( s < P && (double) (2 * prefix + weight[ v ]) * P > 2.0 * s * total )
+			starts[ s++ ] = v;
+		prefix += weight[ v ];
+	}
+	while( s <= P )
+		starts[ s++ ] = n;
+}
+
+static uint64_t row_weight( const struct csr *A, size_t v ) {
+	return A->row_start[ v + 1 ] - A->row_start[ v ] + PARTITION_ROW_COST;
+}
+
+int partition_nonzeros( const struct csr *A, unsigned int P, uint32_t *part ) {
+	uint64_t *weight = malloc( (A->n ? A->n : 1) * sizeof(uint64_t) );
+	size_t *starts = malloc( (P + 1) * sizeof(size_t) );
+	if( weight == NULL || starts == NULL ) {
+		free( weight );
+		free( starts );
+		return -1;
+	}
+	for( size_t v = 0; v < A->n; ++v )
+		weight[ v ] = row_weight( A, v );
+	partition_split( A->n, weight, P, starts );
+	for( unsigned int s = 0; s < P; ++s )
+		for( size_t v = starts[ s ]; v < starts[ s + 1 ]; ++v )
+			part[ v ] = s;
+	free( weight );
+	free( starts );
+	return 0;
+}
+
+//counts a link of v to node u's part, noting the parts seen so far
+static size_t add_link( const uint32_t *part, size_t v, uint32_t u, uint64_t *links, uint32_t *touched, size_t ntouched ) {
+	if( u != v && links[ part[ u ] ]++ == 0 )
+		touched[ ntouched++ ] = part[ u ];
+	return ntouched;
+}
+
+int partition_label_propagation( const struct graph *g, unsigned int P, uint32_t *part ) {
+	const struct csr *A = &g->A;
+	struct csr_pattern T;
+	uint64_t *load = calloc( P, sizeof(uint64_t) );
+	uint64_t *links = calloc( P, sizeof(uint64_t) );
+	uint32_t *touched = malloc( P * sizeof(uint32_t) );
+	uint32_t *best_part = malloc( (A->n ? A->n : 1) * sizeof(uint32_t) );
+	if( load == NULL || links == NULL || touched == NULL || best_part == NULL || partition_nonzeros( A, P, part ) != 0 || csr_transpose_pattern( A, &T ) != 0 ) {
+		free( load );
+		free( links );
+		free( touched );
+		free( best_part );
+		return -1;
+	}
+
+	//start from the engine's default split, so the result is never worse
+	//than it; moves only go to parts below the cap
+	for( size_t v = 0; v < A->n; ++v )
+		load[ part[ v ] ] += row_weight( A, v );
+	const uint64_t total = A->nnz + PARTITION_ROW_COST * A->n;
+	const double cap = (1.0 + PARTITION_IMBALANCE) * total / P;
+	//links are only a proxy for the volume, so keep the best round seen
+	memcpy( best_part, part, A->n * sizeof(uint32_t) );
+	size_t best_volume = partition_volume( A, P, part );
+
+	for( unsigned int round = 0; round < PARTITION_ROUNDS; ++round ) {
+		size_t moves = 0;
+		for( size_t v = 0; v < A->n; ++v ) {
+			//links from v to every part: the nodes it reads and the
+			//nodes that read it
+			size_t ntouched = 0;
+			for( uint64_t k = A->row_start[ v ]; k < A->row_start[ v + 1 ]; ++k )
+				ntouched = add_link( part, v, A->col[ k ], links, touched, ntouched );
+			for( uint64_t k = T.start[ v ]; k < T.start[ v + 1 ]; ++k )
+				ntouched = add_link( part, v, T.node[ k ], links, touched, ntouched );
+			const uint32_t from = part[ v ];
+			const uint64_t w = row_weight( A, v );
+			uint32_t best = from;
+			for( size_t t = 0; t < ntouched; ++t ) {
+				const uint32_t to = touched[ t ];
+				if( links[ to ] > links[ best ] && load[ to ] + w <= cap )
+					best = to;
+			}
+			for( size_t t = 0; t < ntouched; ++t )
+				links[ touched[ t ] ] = 0;
+			if( best != from ) {
+				load[ from ] -= w;
+				load[ best ] += w;
+				part[ v ] = best;
+				++moves;
+			}
+		}
+		const size_t volume = partition_volume( A, P, part );
+		if( volume < best_volume ) {
+			best_volume = volume;
+			memcpy( best_part, part, A->n * sizeof(uint32_t) );
+		}
+		if( moves * 1000 < A->n )
+			break;
+	}
+	memcpy( part, best_part, A->n * sizeof(uint32_t) );
+	csr_pattern_free( &T );
+	free( best_part );
+	free( load );
+	free( links );
+	free( touched );
+	return 0;
+}
+
+size_t partition_volume( const struct csr *A, unsigned int P, const uint32_t *part ) {
+	//the rows part by part, and the last part that counted each column
+	uint32_t *perm = malloc( (A->n ? A->n : 1) * sizeof(uint32_t) );
+	uint32_t *rows = malloc( (A->n ? A->n : 1) * sizeof(uint32_t) );
+	uint32_t *counted = malloc( (A->n ? A->n : 1) * sizeof(uint32_t) );
+	size_t *starts = malloc( (P + 1) * sizeof(size_t) );
+	size_t volume = 0;
+	if( perm != NULL && rows != NULL && counted != NULL && starts != NULL ) {
+		partition_order( A->n, P, part, perm, starts );
+		for( size_t v = 0; v < A->n; ++v ) {
+			rows[ perm[ v ] ] = v;
+			counted[ v ] = UINT32_MAX;
+		}
+		for( size_t r = 0; r < A->n; ++r ) {
+			const uint32_t i = rows[ r ], p = part[ i ];
+			for( uint64_t k = A->row_start[ i ]; k < A->row_start[ i + 1 ]; ++k ) {
+				const uint32_t j = A->col[ k ];
+				if( part[ j ] != p && counted[ j ] != p ) {
+					counted[ j ] = p;
+					++volume;
+				}
+			}
+		}
+	}
+	free( perm );
+	free( rows );
+	free( counted );
+	free( starts );
+	return volume;
+}
+
+void partition_order( size_t n, unsigned int P, const uint32_t *part, uint32_t *perm, size_t *starts ) {
+	memset( starts, 0, (P + 1) * sizeof(size_t) );
+	for( size_t v = 0; v < n; ++v )
+		++starts[ part[ v ] + 1 ];
+	for( unsigned int s = 0; s < P; ++s )
+		starts[ s + 1 ] += starts[ s ];
+	for( size_t v = 0; v < n; ++v )
+		perm[ v ] = starts[ part[ v ] ]++;
+	for( unsigned int s = P; s > 0; --s )
+		starts[ s ] = starts[ s - 1 ];
+	starts[ 0 ] = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef _H_PARTITION
+#define _H_PARTITION
+
+#include "loader.h"
+
+//what a row costs its owner besides its nonzeros, in nonzeros: several
+//passes per iteration read and write its vector entry, which on R-MAT graphs
+//takes about as long as multiplying eight nonzeros
+#define PARTITION_ROW_COST 8
+
+//Assignment of the rows, and the matching vector entries, to processors.
+//The engine owns contiguous blocks, so an assignment is applied by
+//renumbering the nodes part by part and handing the engine the block
+//boundaries; the caller maps the results back as for a reordering.
+
+//the P + 1 boundaries that cut n nodes into contiguous blocks of about equal
+//total weight, each boundary at the prefix sum nearest its share
+void partition_split( size_t n, const uint64_t *weight, unsigned int P, size_t *starts );
+
+//part[v] = s for the split the engine uses by default: contiguous blocks of
+//about equal nonzeros, counting PARTITION_ROW_COST more per row.
+//Returns 0 on success, -1 if out of memory.
+int partition_nonzeros( const struct csr *A, unsigned int P, uint32_t *part );
+
+//label propagation: starting from the default split, every node repeatedly
+//moves to the part it has the most in- and out-links to, as long as that
+//part stays within PARTITION_IMBALANCE of the average number of nonzeros;
+//the round with the least volume wins. Returns 0 on success, -1 if out of
+//memory.
+int partition_label_propagation( const struct graph *g, unsigned int P, uint32_t *part );
+
+//the vector entries fetched per iteration with the 1D distribution: for
+//every processor, the distinct columns of its rows that it does not own;
+//0 if out of memory
+size_t partition_volume( const struct csr *A, unsigned int P, const uint32_t *part );
+
+//the renumbering perm[old] = new that makes every part contiguous, keeping
+//the order within a part, and the P + 1 boundaries of the parts
+void partition_order( size_t n, unsigned int P, const uint32_t *part, uint32_t *perm, size_t *starts );
+
+#endif
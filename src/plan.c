@@ -0,0 +1,159 @@
+#include "plan.h"
+#include "arena.h"
+
+#include <mcbsp.h>
+#include <stdlib.h>
+#include <string.h>
+
+//tag of the inspector messages: who asks, how many indices the payload
+//holds, and for a pull where the answer goes in the asking processor's
+//receive buffer. The count travels in the tag because bsp_get_tag of this
+//MulticoreBSP build reports the tag size instead of the payload size.
+struct plan_tag {
+	uint64_t pid;
+	uint64_t count;
+	uint64_t offset;
+	uint64_t half;
+};
+
+static void * checked_malloc( size_t size ) {
+	void *ret = malloc( size ? size : 1 );
+	if( ret == NULL )
+		bsp_abort( "Processor %u: out of memory while building a communication plan\n", bsp_pid() );
+	return ret;
+}
+
+//sends the remote indices of every group of entries to its peer
+static void send_requests( const struct plan_entry *entries, size_t n, size_t half ) {
+	uint32_t *remote = checked_malloc( n * sizeof(uint32_t) );
+	for( size_t k = 0; k < n; ++k )
+		remote[ k ] = entries[ k ].remote;
+	for( size_t first = 0, last; first < n; first = last ) {
+		last = first + 1;
+		while( last < n && entries[ last ].peer == entries[ first ].peer )
+			++last;
+		const struct plan_tag tag = { bsp_pid(), last - first, first, half };
+		bsp_send( entries[ first ].peer, &tag, remote + first, (last - first) * sizeof(uint32_t) );
+	}
+	free( remote );
+}
+
+static size_t count_groups( const struct plan_entry *entries, size_t n ) {
+	size_t groups = 0;
+	for( size_t k = 0; k < n; ++k )
+		groups += k == 0 || entries[ k ].peer != entries[ k - 1 ].peer;
+	return groups;
+}
+
+static void alloc_messages( struct comm_plan *plan, struct arena *arena, size_t nmsgs, size_t nvalues ) {
+	plan->nmsgs = nmsgs;
+	plan->send_pid = arena_alloc( arena, nmsgs * sizeof(unsigned int) );
+	plan->send_start = arena_alloc( arena, (nmsgs + 1) * sizeof(size_t) );
+	plan->send_offset = arena_alloc( arena, nmsgs * sizeof(size_t) );
+	plan->send_half = arena_alloc( arena, nmsgs * sizeof(size_t) );
+	plan->send_index = arena_alloc( arena, nvalues * sizeof(uint32_t) );
+	plan->send_buffer = arena_alloc( arena, nvalues * plan->width * sizeof(double) );
+	plan->send_start[ 0 ] = 0;
+}
+
+void plan_build( struct comm_plan *plan, struct arena *arena, enum plan_direction direction, const struct plan_entry *entries, size_t n, unsigned int width ) {
+	memset( plan, 0, sizeof(*plan) );
+	plan->width = width;
+	MCBSP_BYTESIZE_TYPE tagsize = sizeof(struct plan_tag);
+	bsp_set_tagsize( &tagsize );
+
+	if( direction == PLAN_PULL ) {
+		//we receive into our own entries, in the order of our requests
+		plan->nrecv = n;
+		plan->recv_index = arena_alloc( arena, n * sizeof(uint32_t) );
+		for( size_t k = 0; k < n; ++k )
+			plan->recv_index[ k ] = entries[ k ].local;
+		plan->recv_buffer = arena_alloc_registered( arena, 2 * n * width * sizeof(double) );
+		bsp_sync();
+		send_requests( entries, n, n );
+		bsp_sync();
+
+		//every request becomes one outgoing message
+		MCBSP_NUMMSG_TYPE packets;
+		MCBSP_BYTESIZE_TYPE bytes;
+		bsp_qsize( &packets, &bytes );
+		alloc_messages( plan, arena, packets, bytes / sizeof(uint32_t) );
+		for( size_t m = 0; m < plan->nmsgs; ++m ) {
+			struct plan_tag tag;
+			MCBSP_BYTESIZE_TYPE status;
+			bsp_get_tag( &status, &tag );
+			plan->send_pid[ m ] = tag.pid;
+			plan->send_offset[ m ] = tag.offset;
+			plan->send_half[ m ] = tag.half;
+			bsp_move( plan->send_index + plan->send_start[ m ], tag.count * sizeof(uint32_t) );
+			plan->send_start[ m + 1 ] = plan->send_start[ m ] + tag.count;
+		}
+	} else {
+		//we send our own entries; the peers tell where they go
+		alloc_messages( plan, arena, count_groups( entries, n ), n );
+		for( size_t k = 0, m = 0; k < n; ++k ) {
+			if( k > 0 && entries[ k ].peer != entries[ k - 1 ].peer )
+				plan->send_start[ ++m ] = k;
+			plan->send_pid[ m ] = entries[ k ].peer;
+			plan->send_index[ k ] = entries[ k ].local;
+		}
+		plan->send_start[ plan->nmsgs ] = n;
+		//stays registered until the arena is released
+		size_t *reply = arena_alloc_registered( arena, 2 * bsp_nprocs() * sizeof(size_t) );
+		bsp_sync();
+		send_requests( entries, n, 0 );
+		bsp_sync();
+
+		//every request reserves a range of the receive buffer
+		MCBSP_NUMMSG_TYPE packets;
+		MCBSP_BYTESIZE_TYPE bytes;
+		bsp_qsize( &packets, &bytes );
+		plan->nrecv = bytes / sizeof(uint32_t);
+		plan->recv_index = arena_alloc( arena, plan->nrecv * sizeof(uint32_t) );
+		size_t offset = 0;
+		for( MCBSP_NUMMSG_TYPE m = 0; m < packets; ++m ) {
+			struct plan_tag tag;
+			MCBSP_BYTESIZE_TYPE status;
+			bsp_get_tag( &status, &tag );
+			bsp_move( plan->recv_index + offset, tag.count * sizeof(uint32_t) );
+			const size_t answer[ 2 ] = { offset, plan->nrecv };
+			bsp_put( tag.pid, answer, reply, 2 * bsp_pid() * sizeof(size_t), sizeof(answer) );
+			offset += tag.count;
+		}
+		plan->recv_buffer = arena_alloc_registered( arena, 2 * plan->nrecv * width * sizeof(double) );
+		bsp_sync();
+		for( size_t m = 0; m < plan->nmsgs; ++m ) {
+			plan->send_offset[ m ] = reply[ 2 * plan->send_pid[ m ] ];
+			plan->send_half[ m ] = reply[ 2 * plan->send_pid[ m ] + 1 ];
+		}
+	}
+	bsp_sync();
+}
+
+void plan_send( const struct comm_plan *plan, const double *src ) {
+	const unsigned int width = plan->width;
+	for( size_t m = 0; m < plan->nmsgs; ++m ) {
+		const size_t first = plan->send_start[ m ], last = plan->send_start[ m + 1 ];
+		for( size_t k = first; k < last; ++k )
+			for( unsigned int j = 0; j < width; ++j )
+				plan->send_buffer[ k * width + j ] = src[ plan->send_index[ k ] * width + j ];
+		bsp_hpput( plan->send_pid[ m ], plan->send_buffer + first * width, plan->recv_buffer,
+			(plan->parity * plan->send_half[ m ] + plan->send_offset[ m ]) * width * sizeof(double),
+			(last - first) * width * sizeof(double) );
+	}
+}
+
+void plan_receive( struct comm_plan *plan, double *dest, int accumulate ) {
+	const unsigned int width = plan->width;
+	const double *in = plan->recv_buffer + plan->parity * plan->nrecv * width;
+	if( accumulate ) {
+		for( size_t k = 0; k < plan->nrecv; ++k )
+			for( unsigned int j = 0; j < width; ++j )
+				dest[ plan->recv_index[ k ] * width + j ] += in[ k * width + j ];
+	} else {
+		for( size_t k = 0; k < plan->nrecv; ++k )
+			for( unsigned int j = 0; j < width; ++j )
+				dest[ plan->recv_index[ k ] * width + j ] = in[ k * width + j ];
+	}
+	plan->parity ^= 1;
+}
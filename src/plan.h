@@ -0,0 +1,66 @@
+#ifndef _H_PLAN
+#define _H_PLAN
+
+#include <stddef.h>
+#include <stdint.h>
+
+//A fixed communication pattern, worked out once (inspector) and replayed
+//every iteration (executor): each peer gets one packed bsp_hpput of exactly
+//the values it needs. All buffers come from the processor's arena, so
+//nothing is allocated after plan_build and the plan is released with it.
+
+enum plan_direction {
+	//the peer sends its entry `remote' into our entry `local' (fan-out)
+	PLAN_PULL = 0,
+	//we send our entry `local' and the peer adds it to its entry `remote'
+	//(fan-in)
+	PLAN_PUSH
+};
+
+//one value this processor exchanges with peer
+struct plan_entry {
+	unsigned int peer;
+	uint32_t remote;
+	uint32_t local;
+};
+
+struct arena;
+
+struct comm_plan {
+	//outgoing messages: message m packs src[send_index[k]] for k in
+	//[send_start[m], send_start[m+1]) and puts it to send_pid[m] at element
+	//send_offset[m] of the current half of its receive buffer, whose halves
+	//hold send_half[m] values each
+	size_t nmsgs;
+	unsigned int *send_pid;
+	size_t *send_start;
+	size_t *send_offset;
+	size_t *send_half;
+	uint32_t *send_index;
+	double *send_buffer;
+	//incoming values: value k lands in recv_buffer and belongs to local
+	//entry recv_index[k]. The registered buffer has two halves that are used
+	//in turn, so a peer may already send the next round while this processor
+	//still reads the last one.
+	size_t nrecv;
+	uint32_t *recv_index;
+	double *recv_buffer;
+	unsigned int parity;
+	//doubles per entry: the vectors are interleaved, entry i of vector j
+	//being element i * width + j, and all of an entry's values travel together
+	unsigned int width;
+};
+
+//collective: builds the plan from this processor's entries, which must be
+//grouped by peer, for width interleaved vectors. Ends with a sync, after
+//which the plan can be used.
+void plan_build( struct comm_plan *plan, struct arena *arena, enum plan_direction direction, const struct plan_entry *entries, size_t n, unsigned int width );
+
+//queues this round's values; they arrive during the next sync
+void plan_send( const struct comm_plan *plan, const double *src );
+
+//after that sync: stores (or, with accumulate, adds) the received values into
+//their local entries and moves on to the other half of the receive buffer
+void plan_receive( struct comm_plan *plan, double *dest, int accumulate );
+
+#endif
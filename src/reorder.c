@@ -0,0 +1,374 @@
+#include "reorder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//placed nodes a candidate is scored against in the Gorder-style ordering
+#define GORDER_WINDOW 5
+//in-neighbours with more out-links than this are not used to find
+//siblings: they would cost quadratic time and say little about locality
+#define GORDER_HUB 256
+
+#define NONE UINT32_MAX
+
+int ordering_parse( const char *name, enum ordering *order ) {
+	if( strcmp( name, "none" ) == 0 )
+		*order = ORDER_NONE;
+	else if( strcmp( name, "degree" ) == 0 )
+		*order = ORDER_DEGREE;
+	else if( strcmp( name, "rcm" ) == 0 )
+		*order = ORDER_RCM;
+	else if( strcmp( name, "gorder" ) == 0 )
+		*order = ORDER_GORDER;
+	else
+		return -1;
+	return 0;
+}
+
+const char * ordering_name( enum ordering order ) {
+	switch( order ) {
+	case ORDER_DEGREE:
+		return "degree";
+	case ORDER_RCM:
+		return "rcm";
+	case ORDER_GORDER:
+		return "gorder";
+	default:
+		return "none";
+	}
+}
+
+//in-degree plus out-degree
+static uint64_t degree( const struct csr *A, const struct csr_pattern *T, size_t v ) {
+	return A->row_start[ v + 1 ] - A->row_start[ v ] + T->start[ v + 1 ] - T->start[ v ];
+}
+
+//sorts ids by key, ties by id, with a counting sort as keys are degrees
+static int sort_by_key( size_t n, const uint64_t *key, uint32_t *order, int descending ) {
+	uint64_t max = 0;
+	for( size_t v = 0; v < n; ++v )
+		if( key[ v ] > max )
+			max = key[ v ];
+	uint64_t *count = calloc( max + 2, sizeof(uint64_t) );
+	if( count == NULL )
+		return -1;
+	for( size_t v = 0; v < n; ++v )
+		++count[ (descending ? max - key[ v ] : key[ v ]) + 1 ];
+	for( uint64_t d = 0; d <= max; ++d )
+		count[ d + 1 ] += count[ d ];
+	for( size_t v = 0; v < n; ++v )
+		order[ count[ descending ? max - key[ v ] : key[ v ] ]++ ] = v;
+	free( count );
+	return 0;
+}
+
+static int order_degree( const struct csr *A, const struct csr_pattern *T, uint32_t *perm ) {
+	uint64_t *key = calloc( A->n ? A->n : 1, sizeof(uint64_t) );
+	uint32_t *order = malloc( (A->n ? A->n : 1) * sizeof(uint32_t) );
+	int rc = -1;
+	if( key != NULL && order != NULL ) {
+		for( size_t v = 0; v < A->n; ++v )
+			key[ v ] = degree( A, T, v );
+		rc = sort_by_key( A->n, key, order, 1 );
+		for( size_t k = 0; k < A->n && rc == 0; ++k )
+			perm[ order[ k ] ] = k;
+	}
+	free( key );
+	free( order );
+	return rc;
+}
+
+//degrees for compare_degree, which qsort gives no context
+static const uint64_t *rcm_degree;
+
+static int compare_degree( const void *a, const void *b ) {
+	const uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+	if( rcm_degree[ x ] != rcm_degree[ y ] )
+		return rcm_degree[ x ] < rcm_degree[ y ] ? -1 : 1;
+	return x < y ? -1 : x > y;
+}
+
+static int order_rcm( const struct csr *A, const struct csr_pattern *T, uint32_t *perm ) {
+	const size_t n = A->n;
+	uint64_t *key = calloc( n ? n : 1, sizeof(uint64_t) );
+	uint32_t *by_degree = malloc( (n ? n : 1) * sizeof(uint32_t) );
+	uint32_t *queue = malloc( (n ? n : 1) * sizeof(uint32_t) );
+	char *seen = calloc( n ? n : 1, 1 );
+	int rc = -1;
+	if( key == NULL || by_degree == NULL || queue == NULL || seen == NULL )
+		goto out;
+	for( size_t v = 0; v < n; ++v )
+		key[ v ] = degree( A, T, v );
+	if( sort_by_key( n, key, by_degree, 0 ) != 0 )
+		goto out;
+	//every component starts from its lowest-degree node; the neighbours
+	//a node adds to the queue are put in ascending degree order
+	size_t tail = 0;
+	for( size_t s = 0; s < n; ++s ) {
+		if( seen[ by_degree[ s ] ] )
+			continue;
+		size_t head = tail;
+		queue[ tail++ ] = by_degree[ s ];
+		seen[ by_degree[ s ] ] = 1;
+		while( head < tail ) {
+			const uint32_t v = queue[ head++ ];
+			const size_t first = tail;
+			for( uint64_t k = A->row_start[ v ]; k < A->row_start[ v + 1 ]; ++k )
+				if( !seen[ A->col[ k ] ] ) {
+					seen[ A->col[ k ] ] = 1;
+					queue[ tail++ ] = A->col[ k ];
+				}
+			for( uint64_t k = T->start[ v ]; k < T->start[ v + 1 ]; ++k )
+				if( !seen[ T->node[ k ] ] ) {
+					seen[ T->node[ k ] ] = 1;
+					queue[ tail++ ] = T->node[ k ];
+				}
+			rcm_degree = key;
+			qsort( queue + first, tail - first, sizeof(uint32_t), compare_degree );
+		}
+	}
+	for( size_t k = 0; k < n; ++k )
+		perm[ queue[ k ] ] = n - 1 - k;
+	rc = 0;
+out:
+	free( key );
+	free( by_degree );
+	free( queue );
+	free( seen );
+	return rc;
+}
+
+//the unplaced nodes bucketed by score, so that raising or lowering a score
+//by one and taking a node of the highest score are all O(1)
+struct unit_heap {
+	uint32_t *prev, *next, *head;
+	uint64_t *key;
+	size_t top, nbuckets;
+};
+
+static void heap_unlink( struct unit_heap *h, uint32_t v ) {
+	const size_t b = h->key[ v ] < h->nbuckets ? h->key[ v ] : h->nbuckets - 1;
+	if( h->prev[ v ] != NONE )
+		h->next[ h->prev[ v ] ] = h->next[ v ];
+	else
+		h->head[ b ] = h->next[ v ];
+	if( h->next[ v ] != NONE )
+		h->prev[ h->next[ v ] ] = h->prev[ v ];
+}
+
+static void heap_link( struct unit_heap *h, uint32_t v ) {
+	const size_t b = h->key[ v ] < h->nbuckets ? h->key[ v ] : h->nbuckets - 1;
+	h->prev[ v ] = NONE;
+	h->next[ v ] = h->head[ b ];
+	if( h->head[ b ] != NONE )
+		h->prev[ h->head[ b ] ] = v;
+	h->head[ b ] = v;
+	if( b > h->top )
+		h->top = b;
+}
+
+//placed nodes have key NONE and are left alone
+static void heap_add( struct unit_heap *h, uint32_t v, int delta ) {
+	if( h->key[ v ] == NONE )
+		return;
+	heap_unlink( h, v );
+	h->key[ v ] += delta;
+	heap_link( h, v );
+}
+
+static uint32_t heap_pop( struct unit_heap *h ) {
+	while( h->head[ h->top ] == NONE )
+		--h->top;
+	const uint32_t v = h->head[ h->top ];
+	heap_unlink( h, v );
+	h->key[ v ] = NONE;
+	return v;
+}
+
+//adds delta to the score of every unplaced node related to v: its in- and
+//out-neighbours, and the nodes that share an in-neighbour with it
+static void score_relations( const struct csr *A, const struct csr_pattern *T, struct unit_heap *h, uint32_t v, int delta ) {
+	for( uint64_t k = T->start[ v ]; k < T->start[ v + 1 ]; ++k )
+		heap_add( h, T->node[ k ], delta );
+	for( uint64_t k = A->row_start[ v ]; k < A->row_start[ v + 1 ]; ++k ) {
+		const uint32_t w = A->col[ k ];
+		heap_add( h, w, delta );
+		if( T->start[ w + 1 ] - T->start[ w ] > GORDER_HUB )
+			continue;
+		for( uint64_t l = T->start[ w ]; l < T->start[ w + 1 ]; ++l )
+			if( T->node[ l ] != v )
+				heap_add( h, T->node[ l ], delta );
+	}
+}
+
+static int order_gorder( const struct csr *A, const struct csr_pattern *T, uint32_t *perm ) {
+	const size_t n = A->n;
+	struct unit_heap h;
+	h.nbuckets = n + 1;
+	h.top = 0;
+	h.prev = malloc( (n ? n : 1) * sizeof(uint32_t) );
+	h.next = malloc( (n ? n : 1) * sizeof(uint32_t) );
+	h.head = malloc( h.nbuckets * sizeof(uint32_t) );
+	h.key = calloc( n ? n : 1, sizeof(uint64_t) );
+	uint32_t *order = malloc( (n ? n : 1) * sizeof(uint32_t) );
+	int rc = -1;
+	if( h.prev == NULL || h.next == NULL || h.head == NULL || h.key == NULL || order == NULL )
+		goto out;
+	for( size_t b = 0; b < h.nbuckets; ++b )
+		h.head[ b ] = NONE;
+	for( size_t v = n; v > 0; --v )
+		heap_link( &h, v - 1 );
+	//start from the node with the most in-links
+	size_t start = 0;
+	for( size_t v = 1; v < n; ++v )
+		if( A->row_start[ v + 1 ] - A->row_start[ v ] > A->row_start[ start + 1 ] - A->row_start[ start ] )
+			start = v;
+	for( size_t k = 0; k < n; ++k ) {
+		uint32_t v;
+		if( k == 0 ) {
+			v = start;
+			heap_unlink( &h, v );
+			h.key[ v ] = NONE;
+		} else {
+			v = heap_pop( &h );
+		}
+		order[ k ] = v;
+		score_relations( A, T, &h, v, 1 );
+		if( k >= GORDER_WINDOW )
+			score_relations( A, T, &h, order[ k - GORDER_WINDOW ], -1 );
+	}
+	for( size_t k = 0; k < n; ++k )
+		perm[ order[ k ] ] = k;
+	rc = 0;
+out:
+	free( h.prev );
+	free( h.next );
+	free( h.head );
+	free( h.key );
+	free( order );
+	return rc;
+}
+
+int reorder_compute( const struct graph *g, enum ordering order, uint32_t *perm ) {
+	const struct csr *A = &g->A;
+	if( order == ORDER_NONE ) {
+		for( size_t v = 0; v < A->n; ++v )
+			perm[ v ] = v;
+		return 0;
+	}
+	struct csr_pattern T;
+	if( csr_transpose_pattern( A, &T ) != 0 )
+		return -1;
+	int rc;
+	if( order == ORDER_DEGREE )
+		rc = order_degree( A, &T, perm );
+	else if( order == ORDER_RCM )
+		rc = order_rcm( A, &T, perm );
+	else
+		rc = order_gorder( A, &T, perm );
+	csr_pattern_free( &T );
+	return rc;
+}
+
+struct entry {
+	uint32_t col;
+	double val;
+};
+
+static int compare_entries( const void *a, const void *b ) {
+	const struct entry *x = a, *y = b;
+	return x->col < y->col ? -1 : x->col > y->col;
+}
+
+//a node with its deficit or seed weight, for sorting the node lists
+struct weighted {
+	uint32_t node;
+	double weight;
+};
+
+static int compare_weighted( const void *a, const void *b ) {
+	const struct weighted *x = a, *y = b;
+	return x->node < y->node ? -1 : x->node > y->node;
+}
+
+int graph_permute( struct graph *g, const uint32_t *perm ) {
+	const struct csr *A = &g->A;
+	const size_t n = A->n;
+	struct graph next;
+	memset( &next, 0, sizeof(next) );
+	uint32_t *inverse = malloc( (n ? n : 1) * sizeof(uint32_t) );
+	struct entry *row = NULL;
+	struct weighted *listed = malloc( (g->ndangling ? g->ndangling : 1) * sizeof(struct weighted) );
+	int rc = -1;
+	if( inverse == NULL || listed == NULL || csr_alloc( &next.A, n, A->nnz ) != 0 )
+		goto out;
+	for( size_t v = 0; v < n; ++v )
+		inverse[ perm[ v ] ] = v;
+	uint64_t longest = 0;
+	for( size_t i = 0; i < n; ++i )
+		if( A->row_start[ i + 1 ] - A->row_start[ i ] > longest )
+			longest = A->row_start[ i + 1 ] - A->row_start[ i ];
+	row = malloc( (longest ? longest : 1) * sizeof(struct entry) );
+	if( row == NULL )
+		goto out;
+	struct csr *B = &next.A;
+	for( size_t i = 0; i < n; ++i ) {
+		const uint64_t first = A->row_start[ inverse[ i ] ];
+		const uint64_t length = A->row_start[ inverse[ i ] + 1 ] - first;
+		for( uint64_t k = 0; k < length; ++k )
+			row[ k ] = (struct entry) { perm[ A->col[ first + k ] ], A->val[ first + k ] };
+		qsort( row, length, sizeof(struct entry), compare_entries );
+		for( uint64_t k = 0; k < length; ++k ) {
+			B->col[ B->row_start[ i ] + k ] = row[ k ].col;
+			B->val[ B->row_start[ i ] + k ] = row[ k ].val;
+		}
+		B->row_start[ i + 1 ] = B->row_start[ i ] + length;
+	}
+
+	next.ndangling = g->ndangling;
+	next.dangling = malloc( (g->ndangling ? g->ndangling : 1) * sizeof(uint32_t) );
+	if( g->deficit != NULL )
+		next.deficit = malloc( (g->ndangling ? g->ndangling : 1) * sizeof(double) );
+	if( next.dangling == NULL || (g->deficit != NULL && next.deficit == NULL) )
+		goto out;
+	for( size_t k = 0; k < g->ndangling; ++k )
+		listed[ k ] = (struct weighted) { perm[ g->dangling[ k ] ], g->deficit != NULL ? g->deficit[ k ] : 1.0 };
+	qsort( listed, g->ndangling, sizeof(struct weighted), compare_weighted );
+	for( size_t k = 0; k < g->ndangling; ++k ) {
+		next.dangling[ k ] = listed[ k ].node;
+		if( next.deficit != NULL )
+			next.deficit[ k ] = listed[ k ].weight;
+	}
+	graph_free( g );
+	*g = next;
+	rc = 0;
+out:
+	if( rc != 0 )
+		graph_free( &next );
+	free( inverse );
+	free( row );
+	free( listed );
+	return rc;
+}
+
+int personalization_permute( struct personalization *p, const uint32_t *perm ) {
+	struct weighted *seeds = malloc( (p->count ? p->count : 1) * sizeof(struct weighted) );
+	if( seeds == NULL )
+		return -1;
+	for( size_t k = 0; k < p->count; ++k )
+		seeds[ k ] = (struct weighted) { perm[ p->node[ k ] ], p->weight[ k ] };
+	qsort( seeds, p->count, sizeof(struct weighted), compare_weighted );
+	for( size_t k = 0; k < p->count; ++k ) {
+		p->node[ k ] = seeds[ k ].node;
+		p->weight[ k ] = seeds[ k ].weight;
+	}
+	free( seeds );
+	return 0;
+}
+
+double average_column_gap( const struct csr *A ) {
+	double sum = 0.0;
+	for( size_t k = 1; k < A->nnz; ++k )
+		sum += A->col[ k ] > A->col[ k - 1 ] ? A->col[ k ] - A->col[ k - 1 ] : A->col[ k - 1 ] - A->col[ k ];
+	return A->nnz > 1 ? sum / (A->nnz - 1) : 0.0;
+}
@@ -0,0 +1,42 @@
+#ifndef _H_REORDER
+#define _H_REORDER
+
+#include "loader.h"
+
+//Renumbering of the nodes before the matrix is distributed, so that the
+//x[col] reads of a row fall close together. A permutation maps every
+//original id to its new id; the engine only ever sees the new ids and the
+//caller maps the results back.
+
+enum ordering {
+	ORDER_NONE = 0,
+	//by total degree, highest first, so the hubs share a few cache lines
+	ORDER_DEGREE,
+	//reverse Cuthill-McKee on the symmetrised graph: breadth-first from a
+	//low-degree node per component, neighbours by ascending degree, reversed
+	ORDER_RCM,
+	//Gorder-style greedy: the next node is the one with the most links to,
+	//and in-neighbours shared with, the last GORDER_WINDOW placed nodes
+	ORDER_GORDER
+};
+
+//parses an ordering name as given on the command line, returns -1 if unknown
+int ordering_parse( const char *name, enum ordering *order );
+
+const char * ordering_name( enum ordering order );
+
+//computes perm[old] = new for g, returns 0 on success or -1 if out of memory
+int reorder_compute( const struct graph *g, enum ordering order, uint32_t *perm );
+
+//renumbers g in place by perm, keeping every row's columns ascending;
+//returns 0 on success, or -1 if out of memory with g left unchanged
+int graph_permute( struct graph *g, const uint32_t *perm );
+
+//renumbers the seeds of p and sorts them again
+int personalization_permute( struct personalization *p, const uint32_t *perm );
+
+//the mean distance between consecutive column indices in row order: a proxy
+//for the cache misses of the x[col] reads in the product
+double average_column_gap( const struct csr *A );
+
+#endif
@@ -0,0 +1,131 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "steal.h"
+#include "arena.h"
+
+#include <sched.h>
+
+#define FRONT( ends ) ((ends) & 0xffffffffu)
+#define BACK( ends ) ((ends) >> 32)
+
+//the rows listed by q->rows, or all local rows
+static size_t row_of( const struct steal_queue *q, size_t i ) {
+	return q->rows != NULL ? q->rows[ i ] : i;
+}
+
+//cuts the nrows rows listed in rows, or all local rows if rows is NULL, into
+//chunks: chunk c ends at the first row past (c+1)/nchunks of their
+//nonzeros, counting one more per row
+static void cut( struct steal_queue *q, const uint32_t *rows, size_t nrows ) {
+	q->rows = rows;
+	q->nchunks = q->maxchunks < nrows ? q->maxchunks : nrows;
+	uint64_t total = nrows;
+	for( size_t i = 0; i < nrows && rows != NULL; ++i )
+		total += q->row_start[ rows[ i ] + 1 ] - q->row_start[ rows[ i ] ];
+	if( rows == NULL )
+		total += q->row_start[ nrows ] - q->base;
+	size_t i = 0;
+	uint64_t before = 0;
+	q->bound[ 0 ] = 0;
+	for( size_t c = 1; c < q->nchunks; ++c ) {
+		while( i < nrows && before * q->nchunks < c * total ) {
+			const size_t r = row_of( q, i++ );
+			before += q->row_start[ r + 1 ] - q->row_start[ r ] + 1;
+		}
+		q->bound[ c ] = i;
+	}
+	q->bound[ q->nchunks ] = nrows;
+}
+
+void steal_init( struct steal_queue *q, struct arena *arena, size_t nrows, const uint64_t *row_start, uint64_t base, const uint32_t *col, const double *val, size_t nchunks ) {
+	q->row_start = row_start;
+	q->base = base;
+	q->col = col;
+	q->val = val;
+	q->stolen = 0;
+	q->nrows = nrows;
+	q->maxchunks = nchunks < nrows ? nchunks : nrows;
+	q->bound = arena_alloc( arena, (q->maxchunks + 1) * sizeof(size_t) );
+	cut( q, NULL, nrows );
+	__atomic_store_n( &q->done, 0, __ATOMIC_RELAXED );
+	__atomic_store_n( &q->ends, 0, __ATOMIC_RELEASE );
+}
+
+//takes a chunk from the front or the back of q; returns 0 if none is left
+static int take( struct steal_queue *q, int front, size_t *c ) {
+	uint64_t ends = __atomic_load_n( &q->ends, __ATOMIC_ACQUIRE );
+	while( FRONT( ends ) < BACK( ends ) ) {
+		const uint64_t next = front ? ends + 1 : ends - ((uint64_t) 1 << 32);
+		if( __atomic_compare_exchange_n( &q->ends, &ends, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+			*c = front ? FRONT( ends ) : BACK( ends ) - 1;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//computes the rows of chunk c, with one kernel call per run of consecutive
+//rows
+static void compute( struct steal_queue *q, size_t c, spmv_kernel spmv, spmm_kernel spmm, double scale ) {
+	const size_t end = q->bound[ c + 1 ];
+	for( size_t a = q->bound[ c ], b; a < end; a = b ) {
+		const size_t r = row_of( q, a );
+		//without a row list the chunk is a single run
+		for( b = q->rows != NULL ? a + 1 : end; b < end && q->rows[ b ] == r + (b - a); ++b )
+			;
+		const size_t n = b - a;
+		const uint64_t k = q->row_start[ r ] - q->base;
+		if( q->width == 1 )
+			spmv( n, q->row_start + r, q->col + k, q->val + k, q->x, scale, q->y + r );
+		else
+			spmm( n, q->row_start + r, q->col + k, q->val + k, q->x, q->width, scale, q->y + r * q->width );
+	}
+	__atomic_add_fetch( &q->done, 1, __ATOMIC_RELEASE );
+}
+
+//publishes the chunks of queues[s], cut for the current product, and
+//computes them together with the other processors
+static void run( struct steal_queue *queues, unsigned int P, unsigned int s, spmv_kernel spmv, spmm_kernel spmm, double scale ) {
+	struct steal_queue *mine = queues + s;
+	__atomic_store_n( &mine->done, 0, __ATOMIC_RELAXED );
+	__atomic_store_n( &mine->ends, (uint64_t) mine->nchunks << 32, __ATOMIC_RELEASE );
+	size_t c;
+	while( take( mine, 1, &c ) )
+		compute( mine, c, spmv, spmm, scale );
+	//help the others until no chunk is left anywhere. A processor that has
+	//not published yet is not waited for: it will do its own chunks.
+	for( int found = 1; found; ) {
+		found = 0;
+		for( unsigned int t = 1; t < P; ++t ) {
+			struct steal_queue *victim = queues + (s + t) % P;
+			if( take( victim, 0, &c ) ) {
+				compute( victim, c, spmv, spmm, scale );
+				++mine->stolen;
+				found = 1;
+			}
+		}
+	}
+	//thieves may still be computing our last chunks
+	while( __atomic_load_n( &mine->done, __ATOMIC_ACQUIRE ) < mine->nchunks )
+		sched_yield();
+}
+
+void steal_multiply( struct steal_queue *queues, unsigned int P, unsigned int s, spmv_kernel spmv, spmm_kernel spmm, double scale, const double *x, double *y, unsigned int width ) {
+	struct steal_queue *mine = queues + s;
+	//no thief reads the chunks of the last round any more
+	if( mine->rows != NULL )
+		cut( mine, NULL, mine->nrows );
+	mine->x = x;
+	mine->y = y;
+	mine->width = width;
+	run( queues, P, s, spmv, spmm, scale );
+}
+
+void steal_multiply_rows( struct steal_queue *queues, unsigned int P, unsigned int s, spmv_kernel spmv, spmm_kernel spmm, double scale, const uint32_t *rows, size_t nrows, const double *x, double *y ) {
+	struct steal_queue *mine = queues + s;
+	cut( mine, rows, nrows );
+	mine->x = x;
+	mine->y = y;
+	mine->width = 1;
+	run( queues, P, s, spmv, spmm, scale );
+}
@@ -0,0 +1,63 @@
+#ifndef _H_STEAL
+#define _H_STEAL
+
+#include "kernel.h"
+
+//Work stealing within the product of a superstep. Every processor cuts its
+//local rows into chunks of about equal nonzeros and puts them on a deque:
+//it takes chunks from the front itself, and once its own are gone, steals
+//from the back of the other processors' deques, so a processor that falls
+//behind is helped by the ones that are done. Whoever takes a chunk computes
+//its rows with the same kernel into the owner's result, so the result does
+//not depend on who did the work. A product over a list of the local rows,
+//such as the rows the adaptive mode still computes, is cut anew by the
+//nonzeros of the listed rows, so processors with few of them left take over
+//the work of the others.
+
+struct arena;
+
+//one processor's deque and the product its chunks belong to. A thief only
+//reads the product after taking a chunk of the round that published it.
+struct steal_queue {
+	//the chunks left, front in the low and back in the high half, so that
+	//one compare-and-swap takes a chunk from either end
+	uint64_t ends;
+	//chunks of the current round finished, by the owner or by thieves
+	uint64_t done;
+	//chunks this processor took from others over the run
+	size_t stolen;
+	//chunk c holds the local rows [bound[c], bound[c+1]), or with a row
+	//list the rows rows[bound[c]] to rows[bound[c+1]-1]; there are at most
+	//maxchunks
+	size_t nchunks, maxchunks;
+	size_t *bound;
+	const uint32_t *rows;
+	//number of local rows
+	size_t nrows;
+	//the local matrix, addressed as by spmv_kernel from row_start[0] = base
+	const uint64_t *row_start;
+	uint64_t base;
+	const uint32_t *col;
+	const double *val;
+	//the current round: y = scale * A x for width interleaved vectors
+	const double *x;
+	double *y;
+	unsigned int width;
+};
+
+//cuts nrows local rows into at most nchunks chunks; the deque stays empty
+//until the first steal_publish
+void steal_init( struct steal_queue *q, struct arena *arena, size_t nrows, const uint64_t *row_start, uint64_t base, const uint32_t *col, const double *val, size_t nchunks );
+
+//computes y = scale * A x for the owner s of queues[s]: publishes its chunks,
+//works through them and then through those of the other processors, and
+//returns once all of its own are done. The owner's x must be complete, and
+//no other processor may change it or y until this returns.
+void steal_multiply( struct steal_queue *queues, unsigned int P, unsigned int s, spmv_kernel spmv, spmm_kernel spmm, double scale, const double *x, double *y, unsigned int width );
+
+//the same for one vector and only the nrows local rows listed in ascending
+//order in rows, which must stay unchanged until this returns; the others
+//keep their entry of y
+void steal_multiply_rows( struct steal_queue *queues, unsigned int P, unsigned int s, spmv_kernel spmv, spmm_kernel spmm, double scale, const uint32_t *rows, size_t nrows, const double *x, double *y );
+
+#endif
@@ -0,0 +1,135 @@
+#include "trace.h"
+#include "plan.h"
+
+#include <mcbsp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void trace_init( struct trace *t, unsigned int nprocs, int record ) {
+	memset( t, 0, sizeof(*t) );
+	t->record = record;
+	t->nprocs = nprocs;
+	t->peer_bytes = calloc( nprocs, sizeof(size_t) );
+	t->peer_messages = calloc( nprocs, sizeof(size_t) );
+	if( t->peer_bytes == NULL || t->peer_messages == NULL )
+		bsp_abort( "Processor %u: out of memory\n", bsp_pid() );
+	t->last = bsp_time();
+}
+
+//the time since the last mark
+static double lap( struct trace *t ) {
+	const double now = bsp_time();
+	const double elapsed = now - t->last;
+	t->last = now;
+	return elapsed;
+}
+
+void trace_compute( struct trace *t ) {
+	t->current.compute += lap( t );
+}
+
+void trace_comm( struct trace *t ) {
+	t->current.comm += lap( t );
+}
+
+static void put( struct trace *t, unsigned int pid, size_t bytes ) {
+	t->peer_bytes[ pid ] += bytes;
+	++t->peer_messages[ pid ];
+	t->current.sent += bytes;
+	++t->current.messages;
+}
+
+void trace_plan( struct trace *t, const struct comm_plan *plan ) {
+	for( size_t m = 0; m < plan->nmsgs; ++m )
+		put( t, plan->send_pid[ m ], (plan->send_start[ m + 1 ] - plan->send_start[ m ]) * plan->width * sizeof(double) );
+	t->current.received += plan->nrecv * plan->width * sizeof(double);
+}
+
+void trace_all( struct trace *t, size_t bytes ) {
+	for( unsigned int k = 0; k < t->nprocs; ++k )
+		put( t, k, bytes );
+	t->current.received += t->nprocs * bytes;
+}
+
+void trace_sync( struct trace *t, unsigned int iteration ) {
+	t->current.sync += lap( t );
+	t->current.iteration = iteration;
+	t->compute += t->current.compute;
+	t->comm += t->current.comm;
+	t->sync += t->current.sync;
+	if( t->record ) {
+		//grows rarely, by doubling, and only when a report was asked for
+		if( t->nsteps == t->capacity ) {
+			const size_t capacity = t->capacity ? 2 * t->capacity : 1024;
+			struct trace_step *steps = realloc( t->steps, capacity * sizeof(struct trace_step) );
+			if( steps == NULL )
+				bsp_abort( "Processor %u: out of memory\n", bsp_pid() );
+			t->steps = steps;
+			t->capacity = capacity;
+		}
+		t->steps[ t->nsteps++ ] = t->current;
+	}
+	memset( &t->current, 0, sizeof(t->current) );
+}
+
+void trace_free( struct trace *t ) {
+	free( t->steps );
+	free( t->peer_bytes );
+	free( t->peer_messages );
+	memset( t, 0, sizeof(*t) );
+}
+
+static void write_json( FILE *file, const struct trace *traces, unsigned int nprocs ) {
+	fprintf( file, "{\n  \"nprocs\": %u,\n  \"processors\": [\n", nprocs );
+	for( unsigned int s = 0; s < nprocs; ++s ) {
+		const struct trace *t = traces + s;
+		fprintf( file, "    {\n      \"pid\": %u,\n      \"compute\": %.9f,\n      \"comm\": %.9f,\n      \"sync\": %.9f,\n", s, t->compute, t->comm, t->sync );
+		if( t->local_bandwidth > 0.0 )
+			fprintf( file, "      \"node\": %d,\n      \"local_bandwidth\": %.6g,\n      \"remote_node\": %d,\n      \"remote_bandwidth\": %.6g,\n",
+				t->node, t->local_bandwidth, t->remote_node, t->remote_bandwidth );
+		fprintf( file, "      \"bytes_to\": [" );
+		for( unsigned int k = 0; k < nprocs; ++k )
+			fprintf( file, "%s%zu", k ? ", " : "", t->peer_bytes[ k ] );
+		fprintf( file, "],\n      \"messages_to\": [" );
+		for( unsigned int k = 0; k < nprocs; ++k )
+			fprintf( file, "%s%zu", k ? ", " : "", t->peer_messages[ k ] );
+		fprintf( file, "],\n      \"supersteps\": [\n" );
+		for( size_t k = 0; k < t->nsteps; ++k ) {
+			const struct trace_step *step = t->steps + k;
+			fprintf( file, "        {\"iteration\": %u, \"compute\": %.9f, \"comm\": %.9f, \"sync\": %.9f, \"sent\": %zu, \"received\": %zu, \"messages\": %zu}%s\n",
+				step->iteration, step->compute, step->comm, step->sync, step->sent, step->received, step->messages, k + 1 < t->nsteps ? "," : "" );
+		}
+		fprintf( file, "      ]\n    }%s\n", s + 1 < nprocs ? "," : "" );
+	}
+	fprintf( file, "  ]\n}\n" );
+}
+
+static void write_csv( FILE *file, const struct trace *traces, unsigned int nprocs ) {
+	fprintf( file, "processor,superstep,iteration,compute,comm,sync,sent,received,messages\n" );
+	for( unsigned int s = 0; s < nprocs; ++s ) {
+		for( size_t k = 0; k < traces[ s ].nsteps; ++k ) {
+			const struct trace_step *step = traces[ s ].steps + k;
+			fprintf( file, "%u,%zu,%u,%.9f,%.9f,%.9f,%zu,%zu,%zu\n", s, k, step->iteration,
+				step->compute, step->comm, step->sync, step->sent, step->received, step->messages );
+		}
+	}
+}
+
+int trace_report( const char *path, const struct trace *traces, unsigned int nprocs ) {
+	FILE *file = fopen( path, "w" );
+	if( file == NULL ) {
+		perror( path );
+		return -1;
+	}
+	const size_t length = strlen( path );
+	if( length >= 5 && strcmp( path + length - 5, ".json" ) == 0 )
+		write_json( file, traces, nprocs );
+	else
+		write_csv( file, traces, nprocs );
+	if( ferror( file ) | fclose( file ) ) {
+		fprintf( stderr, "%s: write failed\n", path );
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef _H_TRACE
+#define _H_TRACE
+
+#include <stddef.h>
+
+//Per-processor instrumentation of an SPMD run. The wall time between marks,
+//taken with bsp_time, is charged to one of three buckets: computation,
+//communication (queueing puts and unpacking what arrived) and waiting in
+//bsp_sync. Every superstep ends at a sync and, when recording, becomes one
+//record with its times and the bytes and messages put in it.
+
+struct comm_plan;
+
+struct trace_step {
+	unsigned int iteration;
+	double compute, comm, sync;
+	size_t sent, received, messages;
+};
+
+struct trace {
+	double last;
+	//totals over the run
+	double compute, comm, sync;
+	//the superstep in progress, and if recording all finished ones
+	struct trace_step current;
+	struct trace_step *steps;
+	size_t nsteps, capacity;
+	int record;
+	//bytes and messages put to every peer over the run
+	unsigned int nprocs;
+	size_t *peer_bytes;
+	size_t *peer_messages;
+	//NUMA mode only: the node of the processor (-1 if not pinned), and its
+	//read bandwidth in bytes per second from its own memory and from that
+	//of a processor on remote_node
+	int node, remote_node;
+	double local_bandwidth, remote_bandwidth;
+};
+
+//starts the clock; with record set every superstep is kept for the report
+void trace_init( struct trace *t, unsigned int nprocs, int record );
+
+//charge the time since the last mark to computation or communication
+void trace_compute( struct trace *t );
+void trace_comm( struct trace *t );
+
+//counts the puts of one plan_send, or of bytes to every processor
+void trace_plan( struct trace *t, const struct comm_plan *plan );
+void trace_all( struct trace *t, size_t bytes );
+
+//charges the time since the last mark to the sync and ends the superstep,
+//which belongs to the given iteration
+void trace_sync( struct trace *t, unsigned int iteration );
+
+void trace_free( struct trace *t );
+
+//writes the traces of all processors to path: JSON if the name ends in
+//.json, otherwise CSV with one line per processor and superstep. Returns 0
+//on success.
+int trace_report( const char *path, const struct trace *traces, unsigned int nprocs );
+
+#endif